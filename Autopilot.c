@@ -0,0 +1,208 @@
+/************ HEADERS ***************/
+
+/* Ordinary C stuff */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+
+#include "Autopilot.h"
+#include "ThreadPool.h"
+#include "Timer.h"
+
+/************ GLOBALS AND DEFINES ***************/
+
+/* search settings - a few milliseconds a move, twenty nodes ahead */
+static float gBudget = 0.005f;
+static int gHorizon = 20 * 60;
+
+/* what being caught costs a rollout, against 10 a dot */
+static const int lossPenalty = 2000;
+
+/* threads a search is split over at most */
+static const int maxSearchThreads = 64;
+
+/* totals over every search, on any thread */
+static long gRollouts = 0;
+static long gSearchMicroseconds = 0;
+
+/* one search for the best way out of a node */
+typedef struct search {
+  const GameState *root;
+  int numWays;
+  int ways[4];			/* MAZE_* bits to choose between */
+  double deadline;
+  Random rng[maxSearchThreads];
+  double total[maxSearchThreads][4];
+  long count[maxSearchThreads][4];
+} Search;
+
+/************ FUNCTION PROTOTYPES ***************/
+
+int needsTurn(const GameState *game);
+int turnNode(const GameState *game);
+int randomWay(const GameState *game, Random *rng);
+double rollout(GameState *scratch, const GameState *root, int way, Random *rng);
+void searchTask(void *context, int task);
+
+/************ SETTINGS ***************/
+
+void AutopilotSetBudget(float seconds)
+{
+  gBudget = std::max(seconds, 0.f);
+}
+
+void AutopilotSetHorizon(int ticks)
+{
+  gHorizon = std::max(ticks, 1);
+}
+
+void AutopilotStats(long *rollouts, double *seconds)
+{
+  *rollouts = gRollouts;
+  *seconds = gSearchMicroseconds * 1e-6;
+}
+
+/************ MOVES ***************/
+
+/*
+  pacman wants a new plan when it has just reached a node and used up
+  the last one, or is standing still without one
+*/
+int needsTurn(const GameState *game)
+{
+  const Pacman *Man = &game->Man;
+
+  return (game->gameStart > 0) && (game->pacmanNewX == 0) && (game->pacmanNewY == 0) &&
+    ((game->gPacmanTimer == 0.f) || ((Man->xMov == 0) && (Man->yMov == 0)));
+}
+
+/* the node the next plan is taken at - the one ahead, or where it stands */
+int turnNode(const GameState *game)
+{
+  const Pacman *Man = &game->Man;
+
+  return MazeNeighbor(game->world, Man->cur, Man->xMov, Man->yMov);
+}
+
+/* a random way on from the turn node, not straight back if there is another */
+int randomWay(const GameState *game, Random *rng)
+{
+  const int back = MazeDirection(-game->Man.xMov, -game->Man.yMov);
+  int ways = game->world->dirs[turnNode(game)];
+  int pick;
+
+  if (ways & ~back)
+    ways &= ~back;
+  if (ways == 0)
+    return 0;
+
+  // the pick-th set bit
+  pick = RandomBelow(rng, __builtin_popcount(ways));
+  while (pick-- > 0)
+    ways &= ways - 1;
+  return ways & -ways;
+}
+
+/************ SEARCHING ***************/
+
+/* play on from root down one way, then at random, and say how it went */
+double rollout(GameState *scratch, const GameState *root, int way, Random *rng)
+{
+  GameInput input = { MazeMoveX(way), MazeMoveZ(way), 0 };
+  double value;
+
+  GameCopy(scratch, root);
+  GameStep(scratch, &input);
+  for (int t = 1; (t < gHorizon) && (scratch->gameStart > 0); t++) {
+    const int next = needsTurn(scratch) ? randomWay(scratch, rng) : 0;
+    input.xMov = MazeMoveX(next);
+    input.yMov = MazeMoveZ(next);
+    GameStep(scratch, &input);
+  }
+
+  value = scratch->score - root->score;
+  if (scratch->gameWin < 0)
+    value -= lossPenalty;
+  return value;
+}
+
+/* roll out the ways in turn until the time is up */
+void searchTask(void *context, int task)
+{
+  Search *search = (Search *) context;
+  GameState *scratch = GameClone(search->root);
+  int w = task % search->numWays;
+
+  // every task does at least one rollout, even when it starts late
+  do {
+    search->total[task][w] += rollout(scratch, search->root, search->ways[w], &search->rng[task]);
+    search->count[task][w]++;
+    w = (w + 1) % search->numWays;
+  } while (GetTimeInSeconds() < search->deadline);
+
+  GameFree(scratch);
+}
+
+/* the input for the next tick of game, searched for at each node */
+void AutopilotPolicy(const GameState *game, Random *rng, GameInput *input)
+{
+  const int tasks = std::min(ThreadPoolSize(), maxSearchThreads);
+  const int current = MazeDirection(game->Man.xMov, game->Man.yMov);
+  const double begin = GetTimeInSeconds();
+  Search search;
+  int ways, best, chosen = 0;
+  double bestMean = 0.;
+  long rollouts = 0;
+
+  input->xMov = 0;
+  input->yMov = 0;
+  input->start = 0;
+  if (!needsTurn(game))
+    return;
+
+  ways = game->world->dirs[turnNode(game)];
+  search.numWays = 0;
+  for (int bit = MAZE_LEFT; bit <= MAZE_DOWN; bit <<= 1)
+    if (ways & bit)
+      search.ways[search.numWays++] = bit;
+  if (search.numWays == 0)
+    return;
+
+  // a corridor leaves nothing to choose
+  best = search.ways[0];
+  if (search.numWays > 1) {
+    search.root = game;
+    search.deadline = begin + gBudget;
+    memset(search.total, 0, sizeof(search.total));
+    memset(search.count, 0, sizeof(search.count));
+    for (int t = 0; t < tasks; t++)
+      RandomSplit(rng, &search.rng[t]);
+    ThreadPoolRun(tasks, searchTask, &search);
+
+    // the best average, keeping on straight when it is as good
+    for (int w = 0; w < search.numWays; w++) {
+      double total = 0.;
+      long count = 0;
+      for (int t = 0; t < tasks; t++) {
+	total += search.total[t][w];
+	count += search.count[t][w];
+      }
+      rollouts += count;
+      if (count == 0)
+	continue;
+      const double mean = total / count;
+      if (!chosen || (mean > bestMean) || ((mean == bestMean) && (search.ways[w] == current))) {
+	chosen = 1;
+	bestMean = mean;
+	best = search.ways[w];
+      }
+    }
+  }
+
+  input->xMov = MazeMoveX(best);
+  input->yMov = MazeMoveZ(best);
+
+  __sync_fetch_and_add(&gRollouts, rollouts);
+  __sync_fetch_and_add(&gSearchMicroseconds, (long) ((GetTimeInSeconds() - begin) * 1e6));
+}
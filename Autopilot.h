@@ -0,0 +1,36 @@
+#ifndef Autopilot_h
+#define Autopilot_h
+
+/*
+ A pacman that plays itself by looking ahead.
+
+ Whenever pacman reaches a node, AutopilotPolicy tries each way out of
+ the node where its next turn will be taken. For every way it copies
+ the game, sends pacman down it and plays on with random turns for a
+ while, all by the real rules of GameStep - ghosts, dots, collisions
+ and all. The way whose rollouts scored best on average, with a heavy
+ cost for being caught, is the one taken.
+
+ Rollouts go on until the time budget for the move runs out, spread
+ over the thread pool with a random stream split off for each thread.
+ Called from inside a pool task, as in a batch, they all run on that
+ task's thread. The number of rollouts depends on the speed of the
+ machine, so an autopilot game is only repeatable through a recording.
+
+ AutopilotPolicy fits BatchPolicy, so it drives batch games as well
+ as the window and the headless runs.
+ */
+
+#include "Game.h"
+
+/* seconds of searching for each move, and how far each rollout looks */
+void AutopilotSetBudget(float seconds);
+void AutopilotSetHorizon(int ticks);
+
+/* the input for the next tick of game, searched for at each node */
+void AutopilotPolicy(const GameState *game, Random *rng, GameInput *input);
+
+/* rollouts and seconds spent searching so far, over every thread */
+void AutopilotStats(long *rollouts, double *seconds);
+
+#endif
@@ -0,0 +1,116 @@
+/************ HEADERS ***************/
+
+/* Ordinary C stuff */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Batch.h"
+#include "ThreadPool.h"
+#include "Timer.h"
+
+/************ GLOBALS AND DEFINES ***************/
+
+typedef struct batchJob {
+  BatchGame *games;
+  BatchPolicy policy;
+} BatchJob;
+
+/************ FUNCTION PROTOTYPES ***************/
+
+void playGame(void *context, int task);
+
+/************ RUNNING A BATCH ***************/
+
+/* play every game and fill in its results */
+void BatchRun(BatchGame *games, int numGames, BatchPolicy policy)
+{
+  BatchJob job;
+
+  job.games = games;
+  job.policy = policy;
+  ThreadPoolRun(numGames, playGame, &job);
+}
+
+/* one whole game, from building its world to the end */
+void playGame(void *context, int task)
+{
+  BatchJob *job = (BatchJob *) context;
+  BatchGame *result = &job->games[task];
+  const double begin = GetTimeInSeconds();
+  World world;
+  GameState *game;
+  GameInput input;
+  Random rng;
+
+  WorldCreate(&world, result->seed, result->gridSize);
+
+  // a world with no maze around pacman's start is noted and skipped
+  result->numDots = world.numDots;
+  result->valid = (world.numDots > 0) && (world.component[world.pacmanStart] >= 0);
+  if (!result->valid) {
+    result->ticks = result->score = result->dotsLeft = result->gameWin = 0;
+    result->seconds = GetTimeInSeconds() - begin;
+    WorldFree(&world);
+    return;
+  }
+
+  game = GameCreate(&world, result->numGhosts);
+  game->chase = result->chase;
+  RandomSeed(&rng, result->seed, RANDOM_INPUT);
+
+  // the first tick starts the game, then it runs until it is decided
+  do {
+    job->policy(game, &rng, &input);
+    input.start = (game->tick == 0);
+    GameStep(game, &input);
+  } while ((game->gameStart > 0) && (game->tick < result->maxTicks));
+
+  result->ticks = game->tick;
+  result->score = game->score;
+  result->dotsLeft = game->numDots;
+  result->gameWin = game->gameWin;
+  result->seconds = GetTimeInSeconds() - begin;
+
+  GameFree(game);
+  WorldFree(&world);
+}
+
+/************ POLICIES ***************/
+
+/* the simplest policy - a random direction every second */
+void BatchWander(const GameState *game, Random *rng, GameInput *input)
+{
+  static const int directions[4][2] = { {-1, 0}, {0, 1}, {1, 0}, {0, -1} };
+
+  input->xMov = 0;
+  input->yMov = 0;
+  input->start = 0;
+  if (game->tick % GameTicksPerSecond == 0) {
+    const int d = RandomBelow(rng, 4);
+    input->xMov = directions[d][0];
+    input->yMov = directions[d][1];
+  }
+}
+
+/************ RESULTS ***************/
+
+/* one line per game, as CSV with a heading or as JSON lines */
+void BatchWrite(FILE *file, const BatchGame *games, int numGames, int jsonLines)
+{
+  if (!jsonLines)
+    fprintf(file, "seed,size,ghosts,chase,valid,dots,ticks,score,dots_left,result,seconds\n");
+
+  for (int i = 0; i < numGames; i++) {
+    const BatchGame *g = &games[i];
+    if (jsonLines)
+      fprintf(file, "{\"seed\":%lu,\"size\":%d,\"ghosts\":%d,\"chase\":%d,\"valid\":%d,\"dots\":%d,"
+	      "\"ticks\":%d,\"score\":%d,\"dots_left\":%d,\"result\":%d,\"seconds\":%.6f}\n",
+	      g->seed, g->gridSize, g->numGhosts, g->chase, g->valid, g->numDots,
+	      g->ticks, g->score, g->dotsLeft, g->gameWin, g->seconds);
+    else
+      fprintf(file, "%lu,%d,%d,%d,%d,%d,%d,%d,%d,%d,%.6f\n",
+	      g->seed, g->gridSize, g->numGhosts, g->chase, g->valid, g->numDots,
+	      g->ticks, g->score, g->dotsLeft, g->gameWin, g->seconds);
+  }
+}
@@ -0,0 +1,50 @@
+#ifndef Batch_h
+#define Batch_h
+
+/*
+ Many whole games at once, for tuning bots and checking maps.
+
+ BatchRun plays every game of a batch from start to finish - build its
+ world, play it with a policy, note how it went - one game per task of
+ the thread pool. Games share nothing, and tasks are handed to threads
+ as they become free, so a batch keeps every core busy even when some
+ games run far longer than others. Work a game would spread over the
+ pool itself, like building its world, runs on the thread the game is
+ on. Every game takes its random numbers from its own seed, so the
+ results never depend on the number of threads.
+ */
+
+#include <stdio.h>
+
+#include "Game.h"
+
+/* the input a policy gives on the next tick of a game */
+typedef void (*BatchPolicy)(const GameState *game, Random *rng, GameInput *input);
+
+/* one game of a batch - the settings, then how it went */
+typedef struct batchGame {
+  unsigned long seed;
+  int gridSize;
+  int numGhosts;
+  int chase;
+  long maxTicks;
+
+  int valid;		/* 0 if its world had no maze to play on, and it was skipped */
+  int numDots;		/* dots and powerpills on the board at the start */
+  int ticks;
+  int score;
+  int dotsLeft;
+  int gameWin;
+  double seconds;
+} BatchGame;
+
+/* play every game and fill in its results */
+void BatchRun(BatchGame *games, int numGames, BatchPolicy policy);
+
+/* the simplest policy - a random direction every second */
+void BatchWander(const GameState *game, Random *rng, GameInput *input);
+
+/* one line per game, as CSV with a heading or as JSON lines */
+void BatchWrite(FILE *file, const BatchGame *games, int numGames, int jsonLines);
+
+#endif
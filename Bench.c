@@ -0,0 +1,311 @@
+/*
+ Microbenchmarks for pacman - build with "make bench".
+
+ Times each stage of building a world (SetHeightMap, SetThresholds,
+ createAdjacencyList), one simulation tick with the usual four ghosts
+ and with a thousand, and one GameCopy snapshot, over many seeds for
+ each map size. Every stage gets one line of JSON with its mean,
+ minimum, median, 90th and 99th percentile and maximum.
+
+ Given a baseline saved from an earlier run, any stage whose median
+ has grown by more than the tolerance is reported as a regression and
+ the exit status is 1.
+
+   ./pacbench [-seeds <n>] [-sizes <a,b,..>] [-ticks <n>] [-threads <n>]
+	      [-out <file>] [-baseline <file>] [-tolerance <percent>]
+ */
+
+/************ HEADERS ***************/
+
+/* Ordinary C stuff */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+
+#include "Game.h"
+#include "Batch.h"
+#include "ThreadPool.h"
+#include "Timer.h"
+
+/************ GLOBALS AND DEFINES ***************/
+
+/* command line options */
+static int gNumSeeds = 30;
+static int gSizes[16] = { 256, 512, 1024 };
+static int gNumSizes = 3;
+static int gTicks = 20000;
+static int gThreads = 0;
+static const char *gOutFile = NULL;
+static const char *gBaselineFile = NULL;
+static float gTolerance = 10.f;
+
+/* seeds are counted up from here, the same ones every run */
+static const unsigned long firstSeed = 1000;
+
+/* ghosts in the crowded tick */
+static const int crowdGhosts = 1000;
+
+/* the stages timed for every seed */
+enum { STAGE_HEIGHTMAP, STAGE_THRESHOLDS, STAGE_MAZE, STAGE_TICK, STAGE_CROWD_TICK,
+       STAGE_COPY, NUM_STAGES };
+
+static const char *stageNames[NUM_STAGES] = {
+  "heightmap", "thresholds", "maze", "tick", "tick_1k_ghosts", "copy"
+};
+static const char *stageUnits[NUM_STAGES] = { "ms", "ms", "ms", "us", "us", "us" };
+
+/* the summary of one stage on one map size */
+typedef struct stageStats {
+  int stage;
+  int size;
+  int samples;
+  double mean, min, p50, p90, p99, max;
+} StageStats;
+
+/************ FUNCTION PROTOTYPES ***************/
+
+int parseOptions(int argc, char **argv);
+void timeWorld(int size, unsigned long seed, double *samples);
+double timeTicks(const World *world, int numGhosts, int ticks);
+double timeCopies(const World *world, int copies);
+void summarise(StageStats *stats, double *samples, int count);
+double percentile(const double *sorted, int count, double p);
+void writeStats(FILE *file, const StageStats *stats);
+int compareBaseline(const char *path, const StageStats *stats, int count);
+double jsonNumber(const char *line, const char *key);
+
+/************ TIMING ***************/
+
+/* build one world a stage at a time, then play on it */
+void timeWorld(int size, unsigned long seed, double *samples)
+{
+  World world;
+  double t;
+
+  WorldAllocate(&world, seed, size);
+  t = GetTimeInSeconds();
+  SetHeightMap(&world);
+  samples[STAGE_HEIGHTMAP] = (GetTimeInSeconds() - t) * 1e3;
+
+  t = GetTimeInSeconds();
+  SetThresholds(&world);
+  samples[STAGE_THRESHOLDS] = (GetTimeInSeconds() - t) * 1e3;
+
+  t = GetTimeInSeconds();
+  createAdjacencyList(&world);
+  samples[STAGE_MAZE] = (GetTimeInSeconds() - t) * 1e3;
+
+  samples[STAGE_TICK] = timeTicks(&world, defaultNumGhosts, gTicks);
+  samples[STAGE_CROWD_TICK] = timeTicks(&world, crowdGhosts, gTicks / 10);
+  samples[STAGE_COPY] = timeCopies(&world, gTicks);
+  WorldFree(&world);
+}
+
+/* microseconds a tick, wandering and starting over whenever a game ends */
+double timeTicks(const World *world, int numGhosts, int ticks)
+{
+  GameState *game = GameCreate(world, numGhosts);
+  GameInput input;
+  Random rng;
+  double t;
+
+  RandomSeed(&rng, world->seed, RANDOM_INPUT);
+  t = GetTimeInSeconds();
+  for (int i = 0; i < ticks; i++) {
+    if (game->gameStart < 1)
+      GameReset(game);
+    BatchWander(game, &rng, &input);
+    input.start = (game->tick == 0);
+    GameStep(game, &input);
+  }
+  t = GetTimeInSeconds() - t;
+  GameFree(game);
+  return t * 1e6 / ticks;
+}
+
+/* microseconds a snapshot, as the window takes one every tick */
+double timeCopies(const World *world, int copies)
+{
+  GameState *game = GameCreate(world, defaultNumGhosts);
+  GameState *copy = GameClone(game);
+  double t = GetTimeInSeconds();
+
+  for (int i = 0; i < copies; i++)
+    GameCopy(copy, game);
+  t = GetTimeInSeconds() - t;
+  GameFree(copy);
+  GameFree(game);
+  return t * 1e6 / copies;
+}
+
+/************ STATISTICS ***************/
+
+/* nearest rank percentile of sorted samples */
+double percentile(const double *sorted, int count, double p)
+{
+  int rank = (int) ceil(p * count);
+
+  return sorted[std::max(0, std::min(rank, count) - 1)];
+}
+
+void summarise(StageStats *stats, double *samples, int count)
+{
+  double total = 0.;
+
+  std::sort(samples, samples + count);
+  for (int i = 0; i < count; i++)
+    total += samples[i];
+  stats->samples = count;
+  stats->mean = total / count;
+  stats->min = samples[0];
+  stats->p50 = percentile(samples, count, 0.50);
+  stats->p90 = percentile(samples, count, 0.90);
+  stats->p99 = percentile(samples, count, 0.99);
+  stats->max = samples[count - 1];
+}
+
+void writeStats(FILE *file, const StageStats *stats)
+{
+  fprintf(file, "{\"stage\":\"%s\",\"size\":%d,\"unit\":\"%s\",\"samples\":%d,"
+	  "\"mean\":%.4f,\"min\":%.4f,\"p50\":%.4f,\"p90\":%.4f,\"p99\":%.4f,\"max\":%.4f}\n",
+	  stageNames[stats->stage], stats->size, stageUnits[stats->stage], stats->samples,
+	  stats->mean, stats->min, stats->p50, stats->p90, stats->p99, stats->max);
+}
+
+/************ BASELINE ***************/
+
+/* the number after key in a line of our own JSON, -1 if it is not there */
+double jsonNumber(const char *line, const char *key)
+{
+  const char *at = strstr(line, key);
+
+  return (at != NULL) ? atof(at + strlen(key)) : -1.;
+}
+
+/*
+  Compare the medians with a baseline written by an earlier run, and
+  report every stage that got slower by more than the tolerance.
+  Returns the number of regressions.
+*/
+int compareBaseline(const char *path, const StageStats *stats, int count)
+{
+  FILE *file = fopen(path, "r");
+  char line[512];
+  int regressions = 0, compared = 0;
+
+  if (file == NULL) {
+    fprintf(stderr, "No baseline in %s, nothing to compare with\n", path);
+    return 0;
+  }
+
+  while (fgets(line, sizeof(line), file) != NULL) {
+    char stage[32];
+    const int size = (int) jsonNumber(line, "\"size\":");
+    const double before = jsonNumber(line, "\"p50\":");
+
+    if (sscanf(line, "{\"stage\":\"%31[^\"]\"", stage) != 1)
+      continue;
+    for (int i = 0; i < count; i++) {
+      if ((strcmp(stageNames[stats[i].stage], stage) != 0) || (stats[i].size != size) ||
+	  (before <= 0.))
+	continue;
+      const double change = (stats[i].p50 / before - 1.) * 100.;
+      compared++;
+      if (change > gTolerance) {
+	fprintf(stderr, "REGRESSION %s size %d: median %.4f -> %.4f %s (+%.1f%%)\n",
+		stage, size, before, stats[i].p50, stageUnits[stats[i].stage], change);
+	regressions++;
+      }
+    }
+  }
+  fclose(file);
+
+  fprintf(stderr, "%d of %d stages slower than the baseline by more than %.0f%%\n",
+	  regressions, compared, gTolerance);
+  return regressions;
+}
+
+/************ COMMAND LINE ***************/
+
+/* 0 if the options make no sense */
+int parseOptions(int argc, char **argv)
+{
+  for (int i = 1; i < argc; i++) {
+    if ((strcmp(argv[i], "-seeds") == 0) && (i + 1 < argc))
+      gNumSeeds = atoi(argv[++i]);
+    else if ((strcmp(argv[i], "-sizes") == 0) && (i + 1 < argc)) {
+      char *list = argv[++i];
+      gNumSizes = 0;
+      for (char *size = strtok(list, ","); (size != NULL) && (gNumSizes < 16); size = strtok(NULL, ","))
+	gSizes[gNumSizes++] = std::max(minGridSize, std::min(atoi(size), maxGridSize));
+    }
+    else if ((strcmp(argv[i], "-ticks") == 0) && (i + 1 < argc))
+      gTicks = atoi(argv[++i]);
+    else if ((strcmp(argv[i], "-threads") == 0) && (i + 1 < argc))
+      gThreads = atoi(argv[++i]);
+    else if ((strcmp(argv[i], "-out") == 0) && (i + 1 < argc))
+      gOutFile = argv[++i];
+    else if ((strcmp(argv[i], "-baseline") == 0) && (i + 1 < argc))
+      gBaselineFile = argv[++i];
+    else if ((strcmp(argv[i], "-tolerance") == 0) && (i + 1 < argc))
+      gTolerance = atof(argv[++i]);
+    else {
+      fprintf(stderr, "Unknown option %s\n", argv[i]);
+      return 0;
+    }
+  }
+  return (gNumSeeds > 0) && (gNumSizes > 0) && (gTicks >= 10);
+}
+
+/************ GOOD OLD INT MAIN() ***************/
+
+int main(int argc, char **argv)
+{
+  StageStats stats[16 * NUM_STAGES];
+  double *samples[NUM_STAGES];
+  double seedSamples[NUM_STAGES];
+  int numStats = 0;
+  FILE *out = stdout;
+  int regressions = 0;
+
+  if (!parseOptions(argc, argv))
+    return 2;
+  ThreadPoolStart(gThreads);
+  if ((gOutFile != NULL) && ((out = fopen(gOutFile, "w")) == NULL)) {
+    fprintf(stderr, "Could not write to %s\n", gOutFile);
+    return 2;
+  }
+
+  for (int s = 0; s < NUM_STAGES; s++)
+    samples[s] = (double *) malloc(gNumSeeds * sizeof(double));
+
+  for (int z = 0; z < gNumSizes; z++) {
+    for (int i = 0; i < gNumSeeds; i++) {
+      timeWorld(gSizes[z], firstSeed + i, seedSamples);
+      for (int s = 0; s < NUM_STAGES; s++)
+	samples[s][i] = seedSamples[s];
+    }
+
+    for (int s = 0; s < NUM_STAGES; s++) {
+      StageStats *st = &stats[numStats++];
+      st->stage = s;
+      st->size = gSizes[z];
+      summarise(st, samples[s], gNumSeeds);
+      writeStats(out, st);
+      fprintf(stderr, "%-16s size %5d  mean %9.4f  p50 %9.4f  p90 %9.4f  p99 %9.4f %s\n",
+	      stageNames[s], st->size, st->mean, st->p50, st->p90, st->p99, stageUnits[s]);
+    }
+  }
+  if (out != stdout)
+    fclose(out);
+
+  if (gBaselineFile != NULL)
+    regressions = compareBaseline(gBaselineFile, stats, numStats);
+
+  for (int s = 0; s < NUM_STAGES; s++)
+    free(samples[s]);
+  ThreadPoolStop();
+  return (regressions > 0) ? 1 : 0;
+}
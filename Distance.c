@@ -0,0 +1,189 @@
+/************ HEADERS ***************/
+
+/* Ordinary C stuff */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+
+#include "Distance.h"
+#include "ThreadPool.h"
+
+/************ GLOBALS AND DEFINES ***************/
+
+/* sources searched by one task, so each task sets up its queue once */
+static const int sourcesPerTask = 64;
+
+/* what starts a saved table */
+static const char distanceMagic[4] = { 'P', 'M', 'D', 'T' };
+static const int distanceVersion = 1;
+
+typedef struct distanceHeader {
+  char magic[4];
+  int version;
+  unsigned long long seed;
+  int gridSize;
+  int numNodes;
+} DistanceHeader;
+
+typedef struct searchJob {
+  const World *world;
+  DistanceTable *table;
+  int *node;		/* world node of every table row */
+} SearchJob;
+
+/************ FUNCTION PROTOTYPES ***************/
+
+int numberRows(DistanceTable *table, const World *world, int **node);
+void searchSources(void *context, int task);
+void fillHeader(DistanceHeader *header, const World *world, int numNodes);
+
+/************ TABLE CREATION ***************/
+
+/* search the maze of world - 0 if it has too many nodes */
+int DistanceCreate(DistanceTable *table, const World *world)
+{
+  SearchJob job;
+
+  if (!numberRows(table, world, &job.node))
+    return 0;
+
+  table->dist = (unsigned short *) malloc((size_t) table->numNodes * table->numNodes * sizeof(unsigned short));
+  job.world = world;
+  job.table = table;
+  ThreadPoolRun((table->numNodes + sourcesPerTask - 1) / sourcesPerTask, searchSources, &job);
+
+  free(job.node);
+  return 1;
+}
+
+void DistanceFree(DistanceTable *table)
+{
+  free(table->row);
+  free(table->dist);
+  table->row = NULL;
+  table->dist = NULL;
+  table->numNodes = 0;
+}
+
+/* give every node of the maze a row, 0 if there are too many */
+int numberRows(DistanceTable *table, const World *world, int **node)
+{
+  int rows = 0;
+
+  table->row = (int *) malloc(world->numNodes * sizeof(int));
+  table->dist = NULL;
+  for (int n = 0; n < world->numNodes; n++)
+    table->row[n] = (world->component[n] >= 0) ? rows++ : -1;
+  table->numNodes = rows;
+
+  if (rows > maxDistanceNodes) {
+    DistanceFree(table);
+    return 0;
+  }
+
+  if (node != NULL) {
+    *node = (int *) malloc((rows > 0 ? rows : 1) * sizeof(int));
+    for (int n = 0; n < world->numNodes; n++)
+      if (table->row[n] >= 0)
+	(*node)[table->row[n]] = n;
+  }
+  return 1;
+}
+
+/* fill the rows of one task's sources, a breadth first search each */
+void searchSources(void *context, int task)
+{
+  SearchJob *job = (SearchJob *) context;
+  const World *world = job->world;
+  DistanceTable *table = job->table;
+  const int first = task * sourcesPerTask;
+  const int last = std::min(first + sourcesPerTask, table->numNodes);
+  int *queue = (int *) malloc(table->numNodes * sizeof(int));
+
+  for (int source = first; source < last; source++) {
+    unsigned short *dist = table->dist + (size_t) source * table->numNodes;
+    int head = 0, tail = 0;
+
+    memset(dist, 0xff, table->numNodes * sizeof(unsigned short));
+    dist[source] = 0;
+    queue[tail++] = job->node[source];
+    while (head < tail) {
+      const int n = queue[head++];
+      const unsigned short next = dist[table->row[n]] + 1;
+      for (int e = world->adjStart[n]; e < world->adjStart[n + 1]; e++) {
+	const int r = table->row[world->adj[e]];
+	if (dist[r] == DistanceUnreachable) {
+	  dist[r] = next;
+	  queue[tail++] = world->adj[e];
+	}
+      }
+    }
+  }
+
+  free(queue);
+}
+
+/************ SAVING AND LOADING ***************/
+
+void fillHeader(DistanceHeader *header, const World *world, int numNodes)
+{
+  memset(header, 0, sizeof(DistanceHeader));
+  memcpy(header->magic, distanceMagic, sizeof(distanceMagic));
+  header->version = distanceVersion;
+  header->seed = world->seed;
+  header->gridSize = world->gridSize;
+  header->numNodes = numNodes;
+}
+
+/* keep the table in a file - 0 on failure */
+int DistanceSave(const DistanceTable *table, const World *world, const char *path)
+{
+  const size_t entries = (size_t) table->numNodes * table->numNodes;
+  DistanceHeader header;
+  FILE *file = fopen(path, "wb");
+  int ok;
+
+  if (file == NULL)
+    return 0;
+
+  fillHeader(&header, world, table->numNodes);
+  ok = (fwrite(&header, sizeof(header), 1, file) == 1) &&
+    (fwrite(table->dist, sizeof(unsigned short), entries, file) == entries);
+  return (fclose(file) == 0) && ok;
+}
+
+/* read a table saved for this world - 0 if missing or made for another */
+int DistanceLoad(DistanceTable *table, const World *world, const char *path)
+{
+  DistanceHeader header, expected;
+  FILE *file = fopen(path, "rb");
+  size_t entries;
+
+  if (file == NULL)
+    return 0;
+
+  // the rows come from the world, the file only has to agree with them
+  if (!numberRows(table, world, NULL)) {
+    fclose(file);
+    return 0;
+  }
+  fillHeader(&expected, world, table->numNodes);
+  if ((fread(&header, sizeof(header), 1, file) != 1) ||
+      (memcmp(&header, &expected, sizeof(header)) != 0)) {
+    fclose(file);
+    DistanceFree(table);
+    return 0;
+  }
+
+  entries = (size_t) table->numNodes * table->numNodes;
+  table->dist = (unsigned short *) malloc(entries * sizeof(unsigned short));
+  if (fread(table->dist, sizeof(unsigned short), entries, file) != entries) {
+    fclose(file);
+    DistanceFree(table);
+    return 0;
+  }
+
+  fclose(file);
+  return 1;
+}
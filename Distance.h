@@ -0,0 +1,50 @@
+#ifndef Distance_h
+#define Distance_h
+
+/*
+ Shortest distances between every pair of maze nodes.
+
+ DistanceCreate runs one breadth first search from each node of the
+ maze, spread over the thread pool, and keeps the number of steps
+ from every node to every other in a square table of 16 bit entries.
+ After that Distance answers any query with one load, which is what
+ ghost targeting, routes between dots and grading a level all want.
+
+ The table grows with the square of the maze, so it is optional and
+ refused above maxDistanceNodes nodes. It only depends on the world,
+ so it can be saved next to the map with DistanceSave and read back
+ by DistanceLoad instead of searching again; a file made for another
+ seed or size is rejected.
+ */
+
+#include "Game.h"
+
+/* entry for two nodes with no path between them */
+#define DistanceUnreachable 0xffff
+
+/* largest maze the table is built for - 8192 nodes take 128MB */
+static const int maxDistanceNodes = 8192;
+
+typedef struct distanceTable {
+  int numNodes;		/* maze nodes in the table */
+  int *row;		/* table row of every world node, -1 off the maze */
+  unsigned short *dist;	/* numNodes x numNodes steps, row by row */
+} DistanceTable;
+
+/* search the maze of world - 0 if it has too many nodes */
+int DistanceCreate(DistanceTable *table, const World *world);
+void DistanceFree(DistanceTable *table);
+
+/* keep the table in a file - 0 on failure, or if made for another world */
+int DistanceSave(const DistanceTable *table, const World *world, const char *path);
+int DistanceLoad(DistanceTable *table, const World *world, const char *path);
+
+/* steps between world nodes from and to, DistanceUnreachable if none */
+static inline int Distance(const DistanceTable *table, int from, int to)
+{
+  const int a = table->row[from], b = table->row[to];
+  return ((a < 0) || (b < 0)) ? DistanceUnreachable :
+    table->dist[(size_t) a * table->numNodes + b];
+}
+
+#endif
@@ -0,0 +1,387 @@
+/************ HEADERS ***************/
+
+/* Ordinary C stuff */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* GL headers - with the prototypes for buffers, shaders and instancing */
+#define GL_GLEXT_PROTOTYPES
+#include </usr/include/GL/gl.h>
+
+/* Maths library - remember to use -lm if building with GCC */
+#include <math.h>
+
+#include "Dots.h"
+
+/************ GLOBALS AND DEFINES ***************/
+
+/* sphere tessellation, the same as the old glutSolidSphere(1.0, 10, 10) */
+static const int dotSlices = 10;
+static const int dotStacks = 10;
+
+/* one instance per dot - centre in xyz, scale in w (0 once eaten) */
+typedef struct dotInstance {
+  float x;
+  float y;
+  float z;
+  float scale;
+} DotInstance;
+
+static DotInstance *gInstances = NULL;
+static int gNumInstances = 0;
+
+/* the instance slot of every node, -1 if it never had a dot */
+static int *gSlot = NULL;
+static int gNodesPerLine = 0;
+
+/*
+  The dots of each square of dotCellNodes x dotCellNodes nodes hold
+  consecutive slots, so a cell is culled with one box test and the
+  visible cells next to each other are drawn with one call.
+*/
+static const int dotCellNodes = 8;
+
+typedef struct dotCell {
+  int first;		/* first slot of the cell */
+  int count;		/* slots in the cell */
+  int live;		/* dots not eaten yet */
+  float lo[3], hi[3];	/* box around its dots */
+} DotCell;
+
+static DotCell *gCells = NULL;
+static int gCellsPerLine = 0;
+static int gNumCells = 0;
+
+/* GL objects */
+static int gInstanced = 0;
+static GLuint gSphereBuffer = 0;
+static GLuint gSphereIndices = 0;
+static GLuint gInstanceBuffer = 0;
+static GLuint gProgram = 0;
+static GLint gPositionAttrib = -1;
+static GLint gInstanceAttrib = -1;
+static int gNumIndices = 0;
+static GLuint gFallbackList = 0;
+
+/*
+  Lit the same way as the fixed function pipeline lights the rest of
+  the scene - global ambient plus the two directional lights, with
+  the current colour as ambient and diffuse material.
+*/
+static const char *dotVertexShader =
+  "#version 120\n"
+  "attribute vec3 position;\n"
+  "attribute vec4 instance;\n"
+  "varying vec4 colour;\n"
+  "void main() {\n"
+  "  vec4 eye = gl_ModelViewMatrix * vec4(position * instance.w + instance.xyz, 1.0);\n"
+  "  vec3 normal = normalize(gl_NormalMatrix * position);\n"
+  "  vec4 light = gl_LightModel.ambient;\n"
+  "  for (int i = 0; i < 2; i++) {\n"
+  "    vec3 dir = normalize(gl_LightSource[i].position.xyz);\n"
+  "    light += gl_LightSource[i].ambient\n"
+  "      + gl_LightSource[i].diffuse * max(dot(normal, dir), 0.0);\n"
+  "  }\n"
+  "  colour = clamp(gl_Color * light, 0.0, 1.0);\n"
+  "  gl_Position = gl_ProjectionMatrix * eye;\n"
+  "}\n";
+
+static const char *dotFragmentShader =
+  "#version 120\n"
+  "varying vec4 colour;\n"
+  "void main() {\n"
+  "  gl_FragColor = colour;\n"
+  "}\n";
+
+/************ FUNCTION PROTOTYPES ***************/
+
+int instancingSupported(void);
+GLuint compileShader(GLenum type, const char *source);
+GLuint linkDotProgram(void);
+void createSphereBuffers(void);
+void drawRun(int first, int count);
+void drawInstanced(const Frustum *frustum, CullCounts *dots);
+void drawFallback(const Frustum *frustum, CullCounts *dots);
+
+/************ SETUP ***************/
+
+/* check for instanced arrays, either core (3.3) or as an extension */
+int instancingSupported(void) {
+  const char *version = (const char *) glGetString(GL_VERSION);
+  const char *extensions = (const char *) glGetString(GL_EXTENSIONS);
+  int major = 0, minor = 0;
+
+  if ((version != NULL) && (sscanf(version, "%d.%d", &major, &minor) == 2))
+    if ((major > 3) || ((major == 3) && (minor >= 3)))
+      return 1;
+
+  return (extensions != NULL) &&
+    (strstr(extensions, "GL_ARB_instanced_arrays") != NULL);
+}
+
+/* compile one shader stage, 0 on failure */
+GLuint compileShader(GLenum type, const char *source) {
+  GLuint shader = glCreateShader(type);
+  GLint ok = 0;
+
+  glShaderSource(shader, 1, &source, NULL);
+  glCompileShader(shader);
+  glGetShaderiv(shader, GL_COMPILE_STATUS, &ok);
+  if (!ok) {
+    char log[512];
+    glGetShaderInfoLog(shader, sizeof(log), NULL, log);
+    printf("Dot shader: %s\n", log);
+    glDeleteShader(shader);
+    return 0;
+  }
+  return shader;
+}
+
+/* build the dot shader program, 0 on failure */
+GLuint linkDotProgram(void) {
+  GLuint vertex = compileShader(GL_VERTEX_SHADER, dotVertexShader);
+  GLuint fragment = compileShader(GL_FRAGMENT_SHADER, dotFragmentShader);
+  GLuint program;
+  GLint ok = 0;
+
+  if ((vertex == 0) || (fragment == 0))
+    return 0;
+
+  program = glCreateProgram();
+  glAttachShader(program, vertex);
+  glAttachShader(program, fragment);
+  glLinkProgram(program);
+  glDeleteShader(vertex);
+  glDeleteShader(fragment);
+
+  glGetProgramiv(program, GL_LINK_STATUS, &ok);
+  if (!ok) {
+    glDeleteProgram(program);
+    return 0;
+  }
+  return program;
+}
+
+/* a unit sphere - its positions double as its normals */
+void createSphereBuffers(void) {
+  int numVertices = (dotStacks + 1) * (dotSlices + 1);
+  float *vertices = (float *) malloc(numVertices * 3 * sizeof(float));
+  GLushort *indices = (GLushort *) malloc(dotStacks * dotSlices * 6 * sizeof(GLushort));
+  int v = 0;
+
+  for (int i = 0; i <= dotStacks; i++) {
+    float theta = M_PI * i / dotStacks;
+    for (int j = 0; j <= dotSlices; j++) {
+      float phi = 2 * M_PI * j / dotSlices;
+      vertices[v++] = sin(theta) * cos(phi);
+      vertices[v++] = sin(theta) * sin(phi);
+      vertices[v++] = cos(theta);
+    }
+  }
+
+  gNumIndices = 0;
+  for (int i = 0; i < dotStacks; i++) {
+    for (int j = 0; j < dotSlices; j++) {
+      GLushort a = i * (dotSlices + 1) + j;
+      GLushort b = a + dotSlices + 1;
+      indices[gNumIndices++] = a;
+      indices[gNumIndices++] = b;
+      indices[gNumIndices++] = a + 1;
+      indices[gNumIndices++] = a + 1;
+      indices[gNumIndices++] = b;
+      indices[gNumIndices++] = b + 1;
+    }
+  }
+
+  glGenBuffers(1, &gSphereBuffer);
+  glBindBuffer(GL_ARRAY_BUFFER, gSphereBuffer);
+  glBufferData(GL_ARRAY_BUFFER, numVertices * 3 * sizeof(float), vertices, GL_STATIC_DRAW);
+  glGenBuffers(1, &gSphereIndices);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, gSphereIndices);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, gNumIndices * sizeof(GLushort), indices, GL_STATIC_DRAW);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+  free(vertices);
+  free(indices);
+}
+
+/* give every dot on the board an instance slot, lifted above the ground */
+void DotsCreate(const GameState *game, float lift, unsigned int fallbackList)
+{
+  const World *world = game->world;
+  const int numNodes = world->nodesPerLine * world->nodesPerLine;
+
+  gFallbackList = fallbackList;
+  gNodesPerLine = world->nodesPerLine;
+  gCellsPerLine = (gNodesPerLine + dotCellNodes - 1) / dotCellNodes;
+  gNumCells = gCellsPerLine * gCellsPerLine;
+
+  free(gInstances);
+  free(gSlot);
+  free(gCells);
+  gInstances = (DotInstance *) malloc(numNodes * sizeof(DotInstance));
+  gSlot = (int *) malloc(numNodes * sizeof(int));
+  gCells = (DotCell *) malloc(gNumCells * sizeof(DotCell));
+  gNumInstances = 0;
+  for (int c = 0; c < gNumCells; c++) {
+    DotCell *cell = &gCells[c];
+    const int i0 = (c / gCellsPerLine) * dotCellNodes;
+    const int j0 = (c % gCellsPerLine) * dotCellNodes;
+
+    cell->first = gNumInstances;
+    for (int i = i0; (i < i0 + dotCellNodes) && (i < gNodesPerLine); i++) {
+      for (int j = j0; (j < j0 + dotCellNodes) && (j < gNodesPerLine); j++) {
+	const int n = WorldNode(world, i, j);
+	gSlot[n] = -1;
+	if (GameDot(game, n)) {
+	  DotInstance *dot = &gInstances[gNumInstances];
+	  dot->x = world->nodeX[n];
+	  dot->y = WorldHeight(world, world->nodeX[n], world->nodeZ[n]) + lift;
+	  dot->z = world->nodeZ[n];
+	  dot->scale = 1.;
+	  // the sphere has a radius of one
+	  const float centre[3] = { dot->x, dot->y, dot->z };
+	  for (int k = 0; k < 3; k++) {
+	    if ((gNumInstances == cell->first) || (centre[k] - 1. < cell->lo[k]))
+	      cell->lo[k] = centre[k] - 1.;
+	    if ((gNumInstances == cell->first) || (centre[k] + 1. > cell->hi[k]))
+	      cell->hi[k] = centre[k] + 1.;
+	  }
+	  gSlot[n] = gNumInstances++;
+	}
+      }
+    }
+    cell->count = cell->live = gNumInstances - cell->first;
+  }
+
+  gInstanced = instancingSupported();
+  if (gInstanced && (gProgram == 0)) {
+    gProgram = linkDotProgram();
+    if (gProgram == 0) {
+      gInstanced = 0;
+    } else {
+      gPositionAttrib = glGetAttribLocation(gProgram, "position");
+      gInstanceAttrib = glGetAttribLocation(gProgram, "instance");
+      createSphereBuffers();
+      glGenBuffers(1, &gInstanceBuffer);
+    }
+  }
+  if (!gInstanced) {
+    printf("Instanced dots not supported, drawing them one by one\n");
+    return;
+  }
+
+  glBindBuffer(GL_ARRAY_BUFFER, gInstanceBuffer);
+  glBufferData(GL_ARRAY_BUFFER, gNumInstances * sizeof(DotInstance), gInstances, GL_DYNAMIC_DRAW);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+/************ UPDATES ***************/
+
+/* shrink the eaten dot to nothing, touching only its own slot */
+void DotsClear(int node)
+{
+  const int slot = gSlot[node];
+  const int i = node / gNodesPerLine, j = node % gNodesPerLine;
+
+  if ((slot < 0) || (gInstances[slot].scale == 0.))
+    return;
+
+  gInstances[slot].scale = 0.;
+  gCells[(i / dotCellNodes) * gCellsPerLine + j / dotCellNodes].live--;
+  if (gInstanced) {
+    glBindBuffer(GL_ARRAY_BUFFER, gInstanceBuffer);
+    glBufferSubData(GL_ARRAY_BUFFER, slot * sizeof(DotInstance),
+		    sizeof(DotInstance), &gInstances[slot]);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+  }
+}
+
+/************ DRAWING ***************/
+
+/* one instanced call for the dots in slots first .. first+count-1 */
+void drawRun(int first, int count) {
+  glVertexAttribPointer(gInstanceAttrib, 4, GL_FLOAT, GL_FALSE, 0,
+			(void *) (first * sizeof(DotInstance)));
+  glDrawElementsInstanced(GL_TRIANGLES, gNumIndices, GL_UNSIGNED_SHORT, 0, count);
+}
+
+/* the visible cells, one instanced draw call per run of them */
+void drawInstanced(const Frustum *frustum, CullCounts *dots) {
+  int runFirst = 0, runCount = 0;
+
+  glUseProgram(gProgram);
+
+  glBindBuffer(GL_ARRAY_BUFFER, gSphereBuffer);
+  glEnableVertexAttribArray(gPositionAttrib);
+  glVertexAttribPointer(gPositionAttrib, 3, GL_FLOAT, GL_FALSE, 0, 0);
+
+  glBindBuffer(GL_ARRAY_BUFFER, gInstanceBuffer);
+  glEnableVertexAttribArray(gInstanceAttrib);
+  glVertexAttribDivisor(gInstanceAttrib, 1);
+
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, gSphereIndices);
+  for (int c = 0; c < gNumCells; c++) {
+    const DotCell *cell = &gCells[c];
+    if (cell->live == 0)
+      continue;
+    if (!FrustumBox(frustum, cell->lo, cell->hi)) {
+      dots->culled += cell->live;
+      continue;
+    }
+    dots->drawn += cell->live;
+    if ((runCount > 0) && (runFirst + runCount == cell->first)) {
+      runCount += cell->count;
+    } else {
+      if (runCount > 0)
+	drawRun(runFirst, runCount);
+      runFirst = cell->first;
+      runCount = cell->count;
+    }
+  }
+  if (runCount > 0)
+    drawRun(runFirst, runCount);
+
+  glVertexAttribDivisor(gInstanceAttrib, 0);
+  glDisableVertexAttribArray(gInstanceAttrib);
+  glDisableVertexAttribArray(gPositionAttrib);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  glUseProgram(0);
+}
+
+/* one display list call per dot still standing in the visible cells */
+void drawFallback(const Frustum *frustum, CullCounts *dots) {
+  for (int c = 0; c < gNumCells; c++) {
+    const DotCell *cell = &gCells[c];
+    if (cell->live == 0)
+      continue;
+    if (!FrustumBox(frustum, cell->lo, cell->hi)) {
+      dots->culled += cell->live;
+      continue;
+    }
+    dots->drawn += cell->live;
+    for (int i = cell->first; i < cell->first + cell->count; i++) {
+      if (gInstances[i].scale > 0.) {
+	glPushMatrix();
+	glTranslatef(gInstances[i].x, gInstances[i].y, gInstances[i].z);
+	glCallList(gFallbackList);
+	glPopMatrix();
+      }
+    }
+  }
+}
+
+void DotsDraw(const Frustum *frustum, CullCounts *dots)
+{
+  dots->drawn = dots->culled = 0;
+  if (gNumInstances == 0)
+    return;
+
+  if (gInstanced)
+    drawInstanced(frustum, dots);
+  else
+    drawFallback(frustum, dots);
+}
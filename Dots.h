@@ -0,0 +1,37 @@
+#ifndef Dots_h
+#define Dots_h
+
+/*
+ Dot rendering for pacman.
+
+ Every dot on the board is the same small sphere, so instead of one
+ glCallList per dot we keep one sphere mesh and a per-instance buffer
+ holding the position of each dot, and draw all of them with a single
+ glDrawElementsInstanced. Each dot owns one slot of the instance
+ buffer for the whole game. When pacman eats a dot, DotsClear shrinks
+ that slot to nothing with a 16 byte glBufferSubData - the rest of the
+ board is never walked again.
+
+ Slots are handed out a square of nodes at a time, so every square
+ owns a run of the buffer and a box around its dots. DotsDraw skips
+ the squares outside the view frustum and draws each run of visible
+ squares with one call.
+
+ Instancing needs OpenGL 3.3 or GL_ARB_instanced_arrays and a GLSL
+ 1.20 compiler. Without them DotsDraw falls back to calling the
+ display list given to DotsCreate once for each dot still standing.
+ */
+
+#include "Game.h"
+#include "Frustum.h"
+
+/* build the buffers for every dot still on the board in game */
+void DotsCreate(const GameState *game, float lift, unsigned int fallbackList);
+
+/* remove the dot on the given node from the board */
+void DotsClear(int node);
+
+/* draw every dot that has not been eaten and may be in view */
+void DotsDraw(const Frustum *frustum, CullCounts *dots);
+
+#endif
@@ -0,0 +1,73 @@
+/************ HEADERS ***************/
+
+/* Maths library - remember to use -lm if building with GCC */
+#include <math.h>
+
+#include </usr/include/GL/gl.h>
+
+#include "Frustum.h"
+
+/************ PLANES ***************/
+
+/*
+  With clip = projection * modelview, a point is inside when
+  -w <= x, y, z <= w in clip space, so each plane is the last row of
+  clip plus or minus one of the others.
+*/
+void FrustumFromGL(Frustum *frustum)
+{
+  GLfloat modelview[16], projection[16], clip[16];
+
+  glGetFloatv(GL_MODELVIEW_MATRIX, modelview);
+  glGetFloatv(GL_PROJECTION_MATRIX, projection);
+
+  /* column major, clip[c*4 + r] */
+  for (int c = 0; c < 4; c++)
+    for (int r = 0; r < 4; r++)
+      clip[c*4 + r] = projection[r] * modelview[c*4]
+	+ projection[4 + r] * modelview[c*4 + 1]
+	+ projection[8 + r] * modelview[c*4 + 2]
+	+ projection[12 + r] * modelview[c*4 + 3];
+
+  for (int p = 0; p < 6; p++) {
+    int row = p / 2;
+    float sign = (p % 2 == 0) ? 1. : -1.;
+    float length;
+
+    for (int k = 0; k < 4; k++)
+      frustum->planes[p][k] = clip[k*4 + 3] + sign * clip[k*4 + row];
+
+    /* unit normals, so the sphere test can compare against the radius */
+    length = sqrt(frustum->planes[p][0] * frustum->planes[p][0]
+		  + frustum->planes[p][1] * frustum->planes[p][1]
+		  + frustum->planes[p][2] * frustum->planes[p][2]);
+    for (int k = 0; k < 4; k++)
+      frustum->planes[p][k] /= length;
+  }
+}
+
+/************ TESTS ***************/
+
+int FrustumSphere(const Frustum *frustum, float x, float y, float z, float radius)
+{
+  for (int p = 0; p < 6; p++) {
+    const float *plane = frustum->planes[p];
+    if (plane[0] * x + plane[1] * y + plane[2] * z + plane[3] < -radius)
+      return 0;
+  }
+  return 1;
+}
+
+/* only the corner furthest along each plane's normal needs testing */
+int FrustumBox(const Frustum *frustum, const float lo[3], const float hi[3])
+{
+  for (int p = 0; p < 6; p++) {
+    const float *plane = frustum->planes[p];
+    float d = plane[3];
+    for (int k = 0; k < 3; k++)
+      d += plane[k] * ((plane[k] > 0.) ? hi[k] : lo[k]);
+    if (d < 0.)
+      return 0;
+  }
+  return 1;
+}
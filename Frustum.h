@@ -0,0 +1,37 @@
+#ifndef Frustum_h
+#define Frustum_h
+
+/*
+ View frustum culling for pacman.
+
+ FrustumFromGL takes the six clipping planes out of the current
+ projection and modelview matrices, in world coordinates, right after
+ the camera has been set. Anything whose bounding sphere or box lies
+ entirely behind one of the planes cannot be seen and is never
+ submitted. The tests are conservative - an object near a corner of
+ the frustum may be drawn although it is just out of view, but nothing
+ visible is ever dropped.
+
+ Each drawing pass counts what it drew and what it culled in a
+ CullCounts, so the front end can report them per frame.
+ */
+
+typedef struct frustum {
+  /* a x + b y + c z + d >= 0 inside, for the left, right, bottom,
+     top, near and far planes */
+  float planes[6][4];
+} Frustum;
+
+typedef struct cullCounts {
+  int drawn;
+  int culled;
+} CullCounts;
+
+/* the frustum of the current GL projection and modelview */
+void FrustumFromGL(Frustum *frustum);
+
+/* can a sphere or a box be seen - 0 when it is entirely outside */
+int FrustumSphere(const Frustum *frustum, float x, float y, float z, float radius);
+int FrustumBox(const Frustum *frustum, const float lo[3], const float hi[3]);
+
+#endif
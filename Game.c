@@ -0,0 +1,1140 @@
+/************ HEADERS ***************/
+
+/* Ordinary C stuff */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+
+/* Maths library - remember to use -lm if building with GCC */
+#include <math.h>
+
+#include "Game.h"
+#include "ThreadPool.h"
+
+/************ GLOBALS AND DEFINES ***************/
+
+/* writable views of the ghost arrays at the end of a GameState */
+typedef struct ghostArrays {
+  int *cur;
+  int *step;
+  unsigned char *dir;
+  unsigned char *timer;
+  unsigned char *colour;
+  unsigned long long *occupied;	/* a bit for every node with a ghost on it */
+} GhostArrays;
+
+/* the step through the maze of each MAZE_* bit, filled per world */
+typedef struct stepTable {
+  int step[MAZE_DOWN + 1];
+} StepTable;
+
+/************ FUNCTION PROTOTYPES ***************/
+
+/* Fractal geometry */
+void divideBand(void *context, int task);
+void averageBand(void *context, int task);
+
+/* adjacency list creation */
+int findPacmanStartNode (World *world, const char *ingame, int starterX, int starterZ);
+int regionNode(const World *world, int component);
+int findRoot(int *parent, int n);
+void joinNodes(int *parent, int a, int b);
+void labelStrip(void *context, int task);
+void flattenStrip(void *context, int task);
+void labelComponents(World *world, const char *ingame);
+void setDirections(World *world, const char *ingame);
+void buildAdjacency(World *world);
+void placePowerpill(World *world, int x, int y);
+
+/* game state */
+int bitWords(const World *world);
+GhostArrays ghostArrays(GameState *game);
+void stepTable(const World *world, StepTable *table);
+
+/* chasing */
+const unsigned char *flowTowards(const World *world, int target);
+
+/* ghost manipulations */
+void createGhosts(GameState *game);
+void placeGhost(GameState *game, int ghost, int node, int dir);
+void randomize(GameState *game, GhostArrays *ghosts, int ghost);
+int findStartNode (const World *world, int starterX, int starterZ);
+int spreadStartNode(const World *world, int ghost);
+void checkStartDirection(GameState *game, GhostArrays *ghosts, int ghost);
+void updateGhosts(GameState *game);
+
+/* pacman manipulations */
+void createPacman(GameState *game);
+void refreshPacman(GameState *game);
+void updatePacmanPosition(GameState *game);
+void updatePacmanMovement(GameState *game);
+void checkPacmanMovement(GameState *game);
+void stopPacman(GameState *game);
+
+/* scoring routines */
+void addScores(GameState *game);
+void checkCollision(GameState *game);
+void returnToMenu(GameState *game, int win);
+
+/************ WORLD CREATION ***************/
+
+/* Build the terrain and the maze on top of it, the same one for the same seed */
+void WorldCreate(World *world, unsigned long seed, int gridSize)
+{
+  WorldAllocate(world, seed, gridSize);
+
+  /* Create the heightMap */
+  SetHeightMap(world);
+  SetThresholds(world);
+
+  /* Create adjacency list */
+  createAdjacencyList(world);
+}
+
+/* the arrays of a world, before any of it is built */
+void WorldAllocate(World *world, unsigned long seed, int gridSize)
+{
+  world->seed = seed;
+  world->gridSize = gridSize;
+  world->nodesPerLine = gridSize / DistPaths;
+  world->numNodes = world->nodesPerLine * world->nodesPerLine;
+  world->heightMap = (float *) malloc((size_t) gridSize * gridSize * sizeof(float));
+  world->nodeX = (int *) malloc(world->numNodes * sizeof(int));
+  world->nodeZ = (int *) malloc(world->numNodes * sizeof(int));
+  world->dirs = (unsigned char *) malloc(world->numNodes);
+  world->adjStart = (int *) malloc((world->numNodes + 1) * sizeof(int));
+  world->adj = NULL;
+  world->dot = (char *) malloc(world->numNodes);
+  world->ppill = (char *) malloc(world->numNodes);
+  world->component = (int *) malloc(world->numNodes * sizeof(int));
+  world->componentNodes = NULL;
+  world->componentDots = NULL;
+}
+
+/* give back the memory of a world */
+void WorldFree(World *world)
+{
+  free(world->heightMap);
+  free(world->nodeX);
+  free(world->nodeZ);
+  free(world->dirs);
+  free(world->adjStart);
+  free(world->adj);
+  free(world->dot);
+  free(world->ppill);
+  free(world->component);
+  free(world->componentNodes);
+  free(world->componentDots);
+  memset(world, 0, sizeof(World));
+}
+
+/************ FRACTAL GEOMETRY ***************/
+
+/*
+  The fractal is built on the (size+1) x (size+1) corners of the
+  pixels, where size is the smallest power of two that covers the
+  grid; the heightMap is the corner of the fractal it covers. A
+  square of size s has its corners set already; its midpoint is their
+  average displaced by a random amount, and the midpoints of its edges
+  are the averages of the two corners of each edge. Doing every square of one size before any of the next size
+  down gives the same surface as dividing each square recursively, and
+  the squares of one size are independent of each other so they can
+  be shared out between threads.
+*/
+typedef struct fractalPass {
+  World *world;
+  float *corners;	/* (fractalSize+1) x (fractalSize+1), row major in x */
+  int fractalSize;	/* edge of the whole fractal */
+  int size;		/* edge of the squares divided in this pass */
+  int bandRows;		/* rows of squares per task */
+} FractalPass;
+
+/* rows of squares or pixels handed to one task */
+static const int fractalBandRows = 8;
+
+/* A function to fill the heightMap values using fractal geometry */
+void SetHeightMap(World *world)
+{
+  int gridSize = world->gridSize;
+  int size = 1;
+  size_t stride;
+  float *corners;
+  FractalPass pass;
+  int squares;
+
+  while (size < gridSize)
+    size *= 2;
+  stride = size + 1;
+  corners = (float *) malloc(stride * stride * sizeof(float));
+
+  /* Assign the height of four corners of the initial grid */
+  corners[0] = RandomAt(world->seed, RANDOM_TERRAIN, 0, 0);
+  corners[size * stride] = RandomAt(world->seed, RANDOM_TERRAIN, size, 0);
+  corners[size * stride + size] = RandomAt(world->seed, RANDOM_TERRAIN, size, size);
+  corners[size] = RandomAt(world->seed, RANDOM_TERRAIN, 0, size);
+
+  pass.world = world;
+  pass.corners = corners;
+  pass.fractalSize = size;
+  pass.bandRows = fractalBandRows;
+
+  /* divide every square of one size, then every square of half that size,
+     leaving out the rows of squares that are wholly off the grid */
+  for (pass.size = size; pass.size > 1; pass.size /= 2) {
+    squares = (gridSize + pass.size - 1) / pass.size;
+    ThreadPoolRun((squares + pass.bandRows - 1) / pass.bandRows, divideBand, &pass);
+  }
+
+  /* The four corners of each pixel will be averaged */
+  ThreadPoolRun((gridSize + pass.bandRows - 1) / pass.bandRows, averageBand, &pass);
+  free(corners);
+}
+
+/* divide one band of rows of squares of the current size */
+void divideBand(void *context, int task)
+{
+  FractalPass *pass = (FractalPass *) context;
+  size_t stride = pass->fractalSize + 1;
+  int gridSize = pass->world->gridSize;
+  float *v = pass->corners;
+  int size = pass->size;
+  int half = size / 2;
+  float c1, c2, c3, c4, mid, avg, max;
+
+  max = half / (float)(pass->fractalSize) * 3;
+
+  for (int row = task * pass->bandRows;
+       (row < (task + 1) * pass->bandRows) && (row * size < gridSize); row++) {
+    size_t x = row * size;
+    for (size_t y = 0; y < (size_t) gridSize; y += size) {
+      c1 = v[x * stride + y];
+      c2 = v[(x + size) * stride + y];
+      c3 = v[(x + size) * stride + y + size];
+      c4 = v[x * stride + y + size];
+
+      //Randomly displace the midpoint!
+      avg = (c1 + c2 + c3 + c4) / 4;
+      // special case for the first average to have occluded regions
+      if (size == pass->fractalSize)
+	mid = 1.0f;
+      else
+	mid = avg + (RandomAt(pass->world->seed, RANDOM_TERRAIN, x + half, y + half) - 0.5f) * max;
+
+      //Make sure that the midpoint doesn't accidentally "randomly displaced" past the boundaries!
+      if (mid < 0){
+	mid = 0;
+      }
+      else if (mid > 1.0f){
+	mid = 1.0f;
+      }
+      v[(x + half) * stride + y + half] = mid;
+
+      //Calculate the edges by averaging the two corners of each edge.
+      //Each square sets its own top and left edge, the last row and
+      //column also set the edges on the far side of the grid.
+      v[(x + half) * stride + y] = (c1 + c2) / 2;
+      v[x * stride + y + half] = (c4 + c1) / 2;
+      if (x + size >= (size_t) gridSize)
+	v[(x + size) * stride + y + half] = (c2 + c3) / 2;
+      if (y + size >= (size_t) gridSize)
+	v[(x + half) * stride + y + size] = (c3 + c4) / 2;
+    }
+  }
+}
+
+/* the height of each pixel in one band of rows, from its four corners */
+void averageBand(void *context, int task)
+{
+  FractalPass *pass = (FractalPass *) context;
+  size_t stride = pass->fractalSize + 1;
+  int gridSize = pass->world->gridSize;
+  const float *v = pass->corners;
+
+  for (size_t x = task * pass->bandRows;
+       (x < (size_t) (task + 1) * pass->bandRows) && (x < (size_t) gridSize); x++) {
+    float *row = &pass->world->heightMap[x * gridSize];
+    for (size_t y = 0; y < (size_t) gridSize; y++) {
+      float c = (v[x * stride + y] + v[(x + 1) * stride + y] +
+		 v[(x + 1) * stride + y + 1] + v[x * stride + y + 1]) / 4;
+      row[y] = c*((gridSize/2) -1);
+    }
+  }
+}
+
+/* Sets the height thresholds for snow and water areas */
+void SetThresholds (World *world) {
+  int gridSize = world->gridSize;
+  int perLine = (gridSize + 9) / 10;
+  float *values = (float *) malloc((size_t) perLine * perLine * sizeof(float));
+  int counter = 0;
+  int i, j;
+  for(i = 0; i < gridSize; i = i + 10)
+    {
+      for(j = 0; j < gridSize; j = j + 10)
+	{
+	  values[counter] = WorldHeight(world, i, j);
+	  counter++;
+	}
+    }
+  std::nth_element(values, values + (int)floor(counter * 0.10), values + counter);
+  world->waterThreshold = values[(int)floor(counter * 0.10)];
+  std::nth_element(values, values + (int)floor(counter * 0.90), values + counter);
+  world->snowThreshold = values[(int)floor(counter * 0.90)];
+  free(values);
+
+  // water surface levels the heightMap low values
+  for(size_t n = 0; n < (size_t) gridSize * gridSize; n++)
+    if (world->heightMap[n] < world->waterThreshold)
+      world->heightMap[n] = world->waterThreshold;
+}
+
+/************ ADJACENCY LIST CREATION ***************/
+
+/* each direction out of a node and the move that takes it, in adjacency order */
+static const int mazeMoves[4][3] = {
+  { MAZE_LEFT, -1, 0 }, { MAZE_RIGHT, 1, 0 }, { MAZE_UP, 0, 1 }, { MAZE_DOWN, 0, -1 }
+};
+
+/* columns of nodes labelled by one task */
+static const int labelStripColumns = 32;
+
+typedef struct labelPass {
+  World *world;
+  const char *ingame;
+  int *parent;		/* union-find forest over the nodes, -1 out of the game */
+} LabelPass;
+
+/* creates the adjacency list */
+void createAdjacencyList(World *world) {
+  int NodesPerLine = world->nodesPerLine;
+  int gap = (world->gridSize - (DistPaths * NodesPerLine)) / 2;
+  int height;
+  char *ingame = (char *) malloc(world->numNodes);
+
+  // create all the nodes with pos values
+  for(int i = 0; i < NodesPerLine; i++) {
+    for(int j = 0; j < NodesPerLine; j++) {
+      int n = WorldNode(world, i, j);
+      world->nodeX[n] = gap + (i + (1/2.f)) * DistPaths;
+      world->nodeZ[n] = gap + (j + (1/2.f)) * DistPaths;
+
+      height = WorldHeight(world, world->nodeX[n], world->nodeZ[n]);
+      if((height >= world->snowThreshold) || (height <= world->waterThreshold)) {
+	ingame[n] = 0;
+      } else
+	ingame[n] = 1;
+    }
+  }
+
+  // every region of the map at once, and the moves inside them
+  labelComponents(world, ingame);
+  setDirections(world, ingame);
+  buildAdjacency(world);
+
+  // Pacman's starting node
+  world->startX = NodesPerLine / 2;
+  world->startZ = NodesPerLine / 4;
+  int start = findPacmanStartNode(world, ingame, world->startX, world->startZ);
+
+  // the nodes of pacmans region get the dots
+  for (int n = 0; n < world->numNodes; n++) {
+    world->dot[n] = WorldReachable(world, start, n);
+    world->ppill[n] = 0;
+  }
+  for (int c = 0; c < world->numComponents; c++)
+    world->componentDots[c] = 0;
+  if (world->component[start] >= 0)
+    world->componentDots[world->component[start]] = world->componentNodes[world->component[start]];
+  world->numDots = WorldRegionDots(world, start);
+
+  // place powerpills on the corners
+  for (int i = 0; i < NodesPerLine; i += NodesPerLine - 1)
+    for (int j = 0; j < NodesPerLine; j += NodesPerLine - 1)
+      placePowerpill(world, i, j);
+
+  free(ingame);
+}
+
+/* root of a node, halving the path on the way */
+int findRoot(int *parent, int n) {
+  while (parent[n] != n) {
+    parent[n] = parent[parent[n]];
+    n = parent[n];
+  }
+  return n;
+}
+
+/* join two regions - the smaller root wins, so labels never depend on the order */
+void joinNodes(int *parent, int a, int b) {
+  a = findRoot(parent, a);
+  b = findRoot(parent, b);
+  if (a < b)
+    parent[b] = a;
+  else if (b < a)
+    parent[a] = b;
+}
+
+/* scan one strip of columns, joining each node to the ones below and left of it */
+void labelStrip(void *context, int task) {
+  LabelPass *pass = (LabelPass *) context;
+  const int NodesPerLine = pass->world->nodesPerLine;
+  const int first = task * labelStripColumns;
+  const int last = std::min(first + labelStripColumns, NodesPerLine);
+
+  for (int i = first; i < last; i++) {
+    for (int j = 0; j < NodesPerLine; j++) {
+      const int n = i * NodesPerLine + j;
+      if (!pass->ingame[n]) {
+	pass->parent[n] = -1;
+	continue;
+      }
+      pass->parent[n] = n;
+      if ((j > 0) && pass->ingame[n - 1])
+	joinNodes(pass->parent, n, n - 1);
+      if ((i > first) && pass->ingame[n - NodesPerLine])
+	joinNodes(pass->parent, n, n - NodesPerLine);
+    }
+  }
+}
+
+/* point every node of a strip straight at its root, without writing the forest */
+void flattenStrip(void *context, int task) {
+  LabelPass *pass = (LabelPass *) context;
+  const int NodesPerLine = pass->world->nodesPerLine;
+  const int first = task * labelStripColumns * NodesPerLine;
+  const int last = std::min(first + labelStripColumns * NodesPerLine, pass->world->numNodes);
+
+  for (int n = first; n < last; n++) {
+    int root = pass->parent[n];
+    if (root >= 0)
+      while (pass->parent[root] != root)
+	root = pass->parent[root];
+    pass->world->component[n] = root;
+  }
+}
+
+/*
+  Label every connected region of the ingame nodes. The strips of
+  columns are scanned in parallel with a union-find forest each, the
+  seams between strips are joined afterwards, and the regions are
+  numbered in the order of their first node - so the labels are the
+  same however many threads did the work.
+*/
+void labelComponents(World *world, const char *ingame) {
+  const int NodesPerLine = world->nodesPerLine;
+  const int numStrips = (NodesPerLine + labelStripColumns - 1) / labelStripColumns;
+  LabelPass pass;
+
+  pass.world = world;
+  pass.ingame = ingame;
+  pass.parent = (int *) malloc(world->numNodes * sizeof(int));
+  ThreadPoolRun(numStrips, labelStrip, &pass);
+
+  // the seams between strips
+  for (int s = 1; s < numStrips; s++) {
+    const int i = s * labelStripColumns;
+    for (int j = 0; j < NodesPerLine; j++) {
+      const int n = i * NodesPerLine + j;
+      if (ingame[n] && ingame[n - NodesPerLine])
+	joinNodes(pass.parent, n, n - NodesPerLine);
+    }
+  }
+
+  ThreadPoolRun(numStrips, flattenStrip, &pass);
+
+  // number the roots in order, then hand the numbers down
+  world->numComponents = 0;
+  for (int n = 0; n < world->numNodes; n++)
+    if (world->component[n] == n)
+      pass.parent[n] = world->numComponents++;
+
+  free(world->componentNodes);
+  free(world->componentDots);
+  world->componentNodes = (int *) calloc(world->numComponents + 1, sizeof(int));
+  world->componentDots = (int *) calloc(world->numComponents + 1, sizeof(int));
+  for (int n = 0; n < world->numNodes; n++) {
+    if (world->component[n] >= 0) {
+      world->component[n] = pass.parent[world->component[n]];
+      world->componentNodes[world->component[n]]++;
+    }
+  }
+  free(pass.parent);
+}
+
+/* the directions from every ingame node to its ingame neighbors */
+void setDirections(World *world, const char *ingame) {
+  int NodesPerLine = world->nodesPerLine;
+
+  for (int n = 0; n < world->numNodes; n++) {
+    int x = n / NodesPerLine, y = n % NodesPerLine;
+    int dirs = 0;
+
+    if (ingame[n]) {
+      if ((x > 0) && ingame[n - NodesPerLine])
+	dirs |= MAZE_LEFT;
+      if ((x < NodesPerLine - 1) && ingame[n + NodesPerLine])
+	dirs |= MAZE_RIGHT;
+      if ((y < NodesPerLine - 1) && ingame[n + 1])
+	dirs |= MAZE_UP;
+      if ((y > 0) && ingame[n - 1])
+	dirs |= MAZE_DOWN;
+    }
+    world->dirs[n] = dirs;
+  }
+}
+
+/* lay the neighbors of every node out in compressed sparse rows */
+void buildAdjacency(World *world) {
+  int total = 0;
+
+  for (int n = 0; n < world->numNodes; n++) {
+    world->adjStart[n] = total;
+    total += __builtin_popcount(world->dirs[n]);
+  }
+  world->adjStart[world->numNodes] = total;
+
+  free(world->adj);
+  world->adj = (int *) malloc((total > 0 ? total : 1) * sizeof(int));
+  for (int n = 0; n < world->numNodes; n++) {
+    int *adj = &world->adj[world->adjStart[n]];
+    for (int k = 0; k < 4; k++)
+      if (world->dirs[n] & mazeMoves[k][0])
+	*adj++ = MazeNeighbor(world, n, mazeMoves[k][1], mazeMoves[k][2]);
+  }
+}
+
+/* find a suitable start node for pacman */
+int findPacmanStartNode (World *world, const char *ingame, int starterX, int starterZ) {
+  int largest = -1;
+
+  // the first node up the z line that is in game and has a way out
+  for (; starterZ < world->nodesPerLine; starterZ++) {
+    const int n = WorldNode(world, starterX, starterZ);
+    if (ingame[n] && (world->dirs[n] != 0))
+      return world->pacmanStart = n;
+  }
+
+  // none on the line, so somewhere in the biggest region
+  for (int c = 0; c < world->numComponents; c++)
+    if ((largest < 0) || (world->componentNodes[c] > world->componentNodes[largest]))
+      largest = c;
+  world->pacmanStart = regionNode(world, largest);
+  if (world->pacmanStart < 0)
+    world->pacmanStart = WorldNode(world, world->startX, world->startZ);
+  return world->pacmanStart;
+}
+
+/* the first node of a region with a way out, -1 if there is none */
+int regionNode(const World *world, int component) {
+  if (component < 0)
+    return -1;
+  for (int n = 0; n < world->numNodes; n++)
+    if ((world->component[n] == component) && (world->dirs[n] != 0))
+      return n;
+  return -1;
+}
+
+/* place poerpills on the corners */
+void placePowerpill(World *world, int x, int y) {
+  // check the corners
+  // if there is a dot, replace it with a powerpill
+  int n = WorldNode(world, x, y);
+
+  if (world->dot[n] > 0) {
+    world->dot[n] = 0;
+    world->ppill[n] = 1;
+  }
+}
+
+/************ GAME CONTROL ***************/
+
+/* words of one bitset with a bit for every node of the world */
+int bitWords(const World *world)
+{
+  return (world->numNodes + 63) / 64;
+}
+
+/* bytes taken by a game on the world, bitsets and ghosts included */
+size_t GameSize(const World *world, int numGhosts)
+{
+  const size_t ghostBytes = numGhosts * (2 * sizeof(int) + 3 * sizeof(unsigned char));
+
+  return sizeof(GameState) + 3 * bitWords(world) * sizeof(unsigned long long) +
+    (ghostBytes + 7) / 8 * 8;
+}
+
+/* the ghost arrays of a game, in the order GameState lays them out */
+GhostArrays ghostArrays(GameState *game)
+{
+  GhostArrays ghosts;
+
+  ghosts.occupied = game->bits + 2 * game->numBitWords;
+  ghosts.cur = (int *) (game->bits + 3 * game->numBitWords);
+  ghosts.step = ghosts.cur + game->numGhosts;
+  ghosts.dir = (unsigned char *) (ghosts.step + game->numGhosts);
+  ghosts.timer = ghosts.dir + game->numGhosts;
+  ghosts.colour = ghosts.timer + game->numGhosts;
+  return ghosts;
+}
+
+/* the step through the maze of each MAZE_* bit on this world */
+void stepTable(const World *world, StepTable *table)
+{
+  memset(table, 0, sizeof(StepTable));
+  for (int k = 0; k < 4; k++)
+    table->step[mazeMoves[k][0]] = MazeNeighbor(world, 0, mazeMoves[k][1], mazeMoves[k][2]);
+}
+
+/* a new game on the world with numGhosts ghosts, ready to start */
+GameState *GameCreate(const World *world, int numGhosts)
+{
+  GameState *game;
+
+  numGhosts = std::max(1, std::min(numGhosts, maxNumGhosts));
+  game = (GameState *) malloc(GameSize(world, numGhosts));
+  game->world = world;
+  game->numGhosts = numGhosts;
+  game->chase = 0;
+  GameReset(game);
+  return game;
+}
+
+/* put every object back on its starting node and refill the dots */
+void GameReset(GameState *game)
+{
+  const World *world = game->world;
+  unsigned long long *dots = game->bits;
+  unsigned long long *ppills;
+
+  game->numBitWords = bitWords(world);
+  ppills = game->bits + game->numBitWords;
+  memset(game->bits, 0, 3 * game->numBitWords * sizeof(unsigned long long));
+  for (int n = 0; n < world->numNodes; n++) {
+    dots[n >> 6] |= (unsigned long long) (world->dot[n] > 0) << (n & 63);
+    ppills[n >> 6] |= (unsigned long long) (world->ppill[n] > 0) << (n & 63);
+  }
+  game->numDots = GameCountDots(game);
+  game->score = 0;
+
+  game->gPacmanTimer = 0.;
+  game->gGhostTimer = 0.;
+  game->ghostRate = initialGhostRate;
+  game->pacmanNewX = 0;
+  game->pacmanNewY = 0;
+  game->gameStart = 0;
+  game->gameWin = 0;
+  game->events = 0;
+  game->tick = 0;
+  RandomSeed(&game->ghostRandom, world->seed, RANDOM_GHOSTS);
+
+  /* create objects*/
+  createPacman(game);
+  createGhosts(game);
+}
+
+/* give back the memory of a game */
+void GameFree(GameState *game)
+{
+  free(game);
+}
+
+/* the whole game is one block, so a snapshot is one copy - of the same
+   size only if both games have as many ghosts */
+void GameCopy(GameState *to, const GameState *from)
+{
+  memcpy(to, from, GameSize(from->world, from->numGhosts));
+}
+
+GameState *GameClone(const GameState *game)
+{
+  GameState *clone = (GameState *) malloc(GameSize(game->world, game->numGhosts));
+
+  GameCopy(clone, game);
+  return clone;
+}
+
+int GameCountDots(const GameState *game)
+{
+  int count = 0;
+
+  for (int w = 0; w < 2 * game->numBitWords; w++)
+    count += __builtin_popcountll(game->bits[w]);
+  return count;
+}
+
+/*
+  FNV-1a over every field of a game but the world pointer, one field at
+  a time so the padding between them never counts.
+*/
+unsigned long long GameChecksum(const GameState *game)
+{
+  const GhostArrays ghosts = ghostArrays((GameState *) game);
+  const struct { const void *data; size_t size; } fields[] = {
+    { &game->Man, sizeof(game->Man) }, { &game->numGhosts, sizeof(int) },
+    { &game->numDots, sizeof(int) }, { &game->score, sizeof(int) },
+    { &game->gPacmanTimer, sizeof(float) }, { &game->gGhostTimer, sizeof(float) },
+    { &game->ghostRate, sizeof(float) }, { &game->pacmanNewX, sizeof(int) },
+    { &game->pacmanNewY, sizeof(int) }, { &game->chase, sizeof(int) },
+    { &game->gameStart, sizeof(int) }, { &game->gameWin, sizeof(int) },
+    { &game->tick, sizeof(int) }, { &game->ghostRandom, sizeof(Random) },
+    // the bitsets and the ghost arrays run on to the end of the block
+    { game->bits, (size_t) ((const char *) (ghosts.colour + game->numGhosts) - (const char *) game->bits) }
+  };
+  unsigned long long h = 0xcbf29ce484222325ULL;
+
+  for (size_t f = 0; f < sizeof(fields) / sizeof(fields[0]); f++) {
+    const unsigned char *bytes = (const unsigned char *) fields[f].data;
+    for (size_t b = 0; b < fields[f].size; b++)
+      h = (h ^ bytes[b]) * 0x100000001b3ULL;
+  }
+  return h;
+}
+
+/* start playing from wherever the objects currently are */
+void GameStart(GameState *game)
+{
+  game->score = 0;
+  game->gameStart = 1;
+  game->gameWin = 0;
+}
+
+/*
+  Advance the game by one tick. Pacman and the ghosts move towards
+  their next node and their current node changes once they have
+  covered DistPaths pixels. Returns the GAME_EVENT_* flags raised.
+*/
+int GameStep(GameState *game, const GameInput *input)
+{
+  static const float dt = GameTickSeconds * (float) DistPaths;
+
+  game->events = 0;
+  game->tick++;
+
+  if ((input != NULL) && input->start)
+    GameStart(game);
+
+  // remember the requested direction until pacman reaches a node
+  if ((input != NULL) && ((input->xMov != 0) || (input->yMov != 0))) {
+    game->pacmanNewX = input->xMov;
+    game->pacmanNewY = input->yMov;
+  }
+
+  // nothing moves on the menu
+  if (game->gameStart < 1) {
+    game->gPacmanTimer = 0.;
+    game->gGhostTimer = 0.;
+    return game->events;
+  }
+
+  /* adjust our timer, which we might use for transforming our objects */
+  game->gPacmanTimer += dt;
+  game->gGhostTimer += game->ghostRate * dt;
+
+  // update ghosts current node when timer goes DistPaths pixels
+  if (game->gGhostTimer > (float) DistPaths) {
+    game->gGhostTimer = 0.;
+    updateGhosts(game);
+  }
+
+  // update pacmans current node when timer goes DistPaths pixels
+  if (game->gPacmanTimer > (float) DistPaths) {
+    game->gPacmanTimer = 0.;
+    refreshPacman(game);
+  }
+
+  return game->events;
+}
+
+/* pacmans position on the terrain, part way to its next node */
+void GamePacmanPosition(const GameState *game, float *x, float *z)
+{
+  const Pacman *Man = &game->Man;
+
+  *x = game->world->nodeX[Man->cur] + Man->xMov * game->gPacmanTimer;
+  *z = game->world->nodeZ[Man->cur] + Man->yMov * game->gPacmanTimer;
+}
+
+/* a ghosts position on the terrain, part way to its next node */
+void GameGhostPosition(const GameState *game, int ghost, float *x, float *z)
+{
+  const int cur = GameGhostNodes(game)[ghost];
+  const int dir = GameGhostDirs(game)[ghost];
+
+  *x = game->world->nodeX[cur] + MazeMoveX(dir) * game->gGhostTimer;
+  *z = game->world->nodeZ[cur] + MazeMoveZ(dir) * game->gGhostTimer;
+}
+
+/************ CHASING ***************/
+
+/*
+  A breadth first search from pacman's node over the whole maze gives
+  every node the direction of a shortest path to pacman, so any number of
+  ghosts can each find their next step with one lookup. The field only
+  changes when pacman reaches a new node; until then it is reused.
+  Each thread keeps its own, so games on different threads never
+  share one, and a GameState stays plain data.
+*/
+typedef struct flowField {
+  const World *world;
+  unsigned long seed;	/* tells a rebuilt world at the same address apart */
+  int target;
+  int numNodes;
+  int *queue;
+  unsigned char *step;	/* MAZE_* bit towards the target, 0 if none */
+} FlowField;
+
+static __thread FlowField t_Flow = { NULL, 0, -1, 0, NULL, NULL };
+
+/* the direction to take from every node to reach target */
+const unsigned char *flowTowards(const World *world, int target) {
+  FlowField *flow = &t_Flow;
+  int head = 0, tail = 0;
+
+  if ((flow->world == world) && (flow->seed == world->seed) &&
+      (flow->numNodes == world->numNodes) && (flow->target == target))
+    return flow->step;
+
+  if (flow->numNodes != world->numNodes) {
+    free(flow->queue);
+    free(flow->step);
+    flow->numNodes = world->numNodes;
+    flow->queue = (int *) malloc(flow->numNodes * sizeof(int));
+    flow->step = (unsigned char *) malloc(flow->numNodes);
+  }
+  flow->world = world;
+  flow->seed = world->seed;
+  flow->target = target;
+  memset(flow->step, 0, flow->numNodes);
+
+  // the target is marked with every bit, so it is never queued twice
+  flow->step[target] = MAZE_LEFT | MAZE_RIGHT | MAZE_UP | MAZE_DOWN;
+  flow->queue[tail++] = target;
+  while (head < tail) {
+    const int n = flow->queue[head++];
+    for (int k = 0; k < 4; k++) {
+      if (world->dirs[n] & mazeMoves[k][0]) {
+	const int next = MazeNeighbor(world, n, mazeMoves[k][1], mazeMoves[k][2]);
+	if (flow->step[next] == 0) {
+	  // from next, the way back is the opposite move
+	  flow->step[next] = mazeMoves[k ^ 1][0];
+	  flow->queue[tail++] = next;
+	}
+      }
+    }
+  }
+  flow->step[target] = 0;
+  return flow->step;
+}
+
+/************ GHOST MANIPULATIONS ***************/
+
+/*
+  The first four ghosts start in the middle of the board, each heading
+  its own way. Any more are spread over the maze wherever pacman can
+  reach, away from its start, and set off at random.
+*/
+void createGhosts(GameState *game) {
+  const World *world = game->world;
+  int startX = world->startX;
+  int startZ = world->startZ + world->nodesPerLine / 2;
+
+  // create red ghost going down
+  placeGhost(game, 0, findStartNode(world, startX, startZ), MAZE_DOWN);
+
+  // create cyan ghost going up
+  startZ++;
+  placeGhost(game, 1, findStartNode(world, startX, startZ), MAZE_UP);
+
+  // create orange ghost going right
+  startX++;
+  placeGhost(game, 2, findStartNode(world, startX, startZ), MAZE_RIGHT);
+
+  // create pink ghost going left
+  startX -= 2;
+  placeGhost(game, 3, findStartNode(world, startX, startZ), MAZE_LEFT);
+
+  // and the crowd
+  for (int i = defaultNumGhosts; i < game->numGhosts; i++)
+    placeGhost(game, i, spreadStartNode(world, i), 0);
+}
+
+/* put a ghost on node heading in dir, a random way if it cannot go there */
+void placeGhost(GameState *game, int ghost, int node, int dir) {
+  GhostArrays ghosts = ghostArrays(game);
+  StepTable steps;
+
+  if (ghost >= game->numGhosts)
+    return;
+
+  stepTable(game->world, &steps);
+  ghosts.cur[ghost] = node;
+  ghosts.occupied[node >> 6] |= 1ULL << (node & 63);
+  ghosts.dir[ghost] = dir;
+  ghosts.step[ghost] = steps.step[dir];
+  ghosts.timer[ghost] = ghostRandomTime;
+  ghosts.colour[ghost] = ghost % numGhostColours;
+  if (dir == 0)
+    randomize(game, &ghosts, ghost);
+  else
+    checkStartDirection(game, &ghosts, ghost);
+}
+
+/* if a ghost hits a border, randomize its movement */
+void randomize(GameState *game, GhostArrays *ghosts, int ghost) {
+  const World *world = game->world;
+  const int cur = ghosts->cur[ghost];
+  const int exits = world->adjStart[cur + 1] - world->adjStart[cur];
+  int rn, next;
+
+  // a node with no way out leaves the ghost standing where it is
+  if (exits == 0) {
+    ghosts->step[ghost] = 0;
+    ghosts->dir[ghost] = 0;
+    return;
+  }
+
+  // pick a random node form its adjacent neighbors list
+  rn = RandomBelow(&game->ghostRandom, exits);
+  next = world->adj[world->adjStart[cur] + rn];
+
+  // head for the picked node
+  ghosts->step[ghost] = next - cur;
+  ghosts->dir[ghost] = MazeDirection(world->nodeX[next] - world->nodeX[cur],
+				     world->nodeZ[next] - world->nodeZ[cur]);
+}
+
+/* find a suitable starting node for a ghost, one pacman can reach */
+int findStartNode (const World *world, int starterX, int starterZ) {
+  const int start = world->pacmanStart;
+  int n;
+
+  // check the possibilities on the z line, within the grid
+  if ((starterX >= 0) && (starterX < world->nodesPerLine))
+    for (; starterZ < world->nodesPerLine; starterZ++) {
+      n = WorldNode(world, starterX, starterZ);
+      if (WorldReachable(world, start, n) && (world->dirs[n] != 0))
+	return n;
+    }
+
+  // none there, so anywhere pacman can reach
+  n = regionNode(world, world->component[start]);
+  return (n >= 0) ? n : start;
+}
+
+/* a repeatable node for an extra ghost, reachable and not next to pacman */
+int spreadStartNode(const World *world, int ghost) {
+  static const int clearance = 3;
+  const int npl = world->nodesPerLine;
+  const int start = world->pacmanStart;
+  int n = std::min((int) (RandomAt(world->seed, RANDOM_SPAWN, ghost, 0) * world->numNodes),
+		   world->numNodes - 1);
+
+  for (int tries = 0; tries < world->numNodes; tries++) {
+    if (WorldReachable(world, start, n) && (world->dirs[n] != 0) &&
+	((abs(n / npl - start / npl) > clearance) || (abs(n % npl - start % npl) > clearance)))
+      return n;
+    n = (n + 1) % world->numNodes;
+  }
+  // nowhere clear of pacman, so anywhere in its region
+  n = regionNode(world, world->component[start]);
+  return (n >= 0) ? n : start;
+}
+
+/* check the direction of the ghost in the start to see if its suitable*/
+void checkStartDirection(GameState *game, GhostArrays *ghosts, int ghost) {
+  const int dir = ghosts->dir[ghost];
+
+  // randomize if its not possible to move in that direction
+  if ((dir != 0) && !(game->world->dirs[ghosts->cur[ghost]] & dir))
+    randomize(game, ghosts, ghost);
+}
+
+/*
+  Move every ghost on to its next node. Each pass walks one or two of
+  the arrays straight through with no branches in the loop body, so
+  the compiler can vectorise them; only the few ghosts that have to
+  turn at random take the slow path, in ghost order so the random
+  numbers are drawn just as they would be one ghost at a time.
+*/
+void updateGhosts(GameState *game) {
+  const World *world = game->world;
+  const int numGhosts = game->numGhosts;
+  GhostArrays ghosts = ghostArrays(game);
+  int *__restrict cur = ghosts.cur;
+  int *__restrict step = ghosts.step;
+  unsigned char *__restrict dir = ghosts.dir;
+  unsigned char *__restrict timer = ghosts.timer;
+  unsigned long long *occupied = ghosts.occupied;
+
+  // lift every ghost off the occupancy bitset, a node may hold several
+  for (int i = 0; i < numGhosts; i++)
+    occupied[cur[i] >> 6] &= ~(1ULL << (cur[i] & 63));
+
+  // advance, and count down the ghosts that moved
+  for (int i = 0; i < numGhosts; i++) {
+    cur[i] += step[i];
+    timer[i] -= (dir[i] != 0);
+  }
+
+  // and set them down on their new nodes
+  for (int i = 0; i < numGhosts; i++)
+    occupied[cur[i] >> 6] |= 1ULL << (cur[i] & 63);
+
+  // chasing ghosts head down the field whenever it leads somewhere,
+  // which keeps them off the random turns below
+  if (game->chase) {
+    // the field is only searched again once pacman has moved on
+    const unsigned char *flow = flowTowards(world, game->Man.cur);
+    StepTable steps;
+
+    stepTable(world, &steps);
+    for (int i = 0; i < numGhosts; i++) {
+      const int way = flow[cur[i]];
+      const int follow = (way != 0);
+      dir[i] = follow ? way : dir[i];
+      step[i] = follow ? steps.step[way] : step[i];
+      timer[i] = follow ? ghostRandomTime : timer[i];
+    }
+  }
+
+  // turn when the timer runs out, and again if a border is ahead
+  // in the direction it came
+  for (int i = 0; i < numGhosts; i++) {
+    if ((dir[i] != 0) && ((timer[i] == 0) || !(world->dirs[cur[i]] & dir[i]))) {
+      const int blocked = !(world->dirs[cur[i]] & dir[i]);
+      if (timer[i] == 0) {
+	randomize(game, &ghosts, i);
+	timer[i] = ghostRandomTime;
+      }
+      if (blocked)
+	randomize(game, &ghosts, i);
+    }
+  }
+}
+
+/************ PACMAN MANIPULATIONS ***************/
+
+/* create pacman by filling its fields */
+void createPacman(GameState *game) {
+  game->Man.alive = 1;
+  game->Man.xMov = 0;
+  game->Man.yMov = 0;
+  game->Man.cur = game->world->pacmanStart;
+}
+
+/* refresh pacmans position */
+void refreshPacman(GameState *game) {
+  checkCollision(game);
+
+  updatePacmanPosition(game);
+  updatePacmanMovement(game);
+  checkPacmanMovement(game);
+
+  addScores(game);
+  checkCollision(game);
+}
+
+/* update pacmans position */
+void updatePacmanPosition(GameState *game) {
+  Pacman *Man = &game->Man;
+
+  // change the node according to the direction
+  Man->cur = MazeNeighbor(game->world, Man->cur, Man->xMov, Man->yMov);
+}
+
+/* update pacmans direction */
+void updatePacmanMovement(GameState *game) {
+  // get the read from keyboard and update pacmans movement in the next node
+  if ((game->pacmanNewX != 0) || (game->pacmanNewY != 0)) {
+    game->Man.xMov = game->pacmanNewX;
+    game->Man.yMov = game->pacmanNewY;
+    game->pacmanNewX = 0;
+    game->pacmanNewY = 0;
+  }
+}
+
+/* check pacmans direction to see if its suitable*/
+void checkPacmanMovement(GameState *game) {
+  Pacman *Man = &game->Man;
+  const World *world = game->world;
+  int dir = MazeDirection(Man->xMov, Man->yMov);
+  int next;
+
+  if (dir == 0)
+    return;
+
+  // if it is trying to go to a border, stop
+  if (!(world->dirs[Man->cur] & dir)) {
+    stopPacman(game);
+    return;
+  }
+
+  // if Pacman is going uphill slow down ghosts
+  next = MazeNeighbor(world, Man->cur, Man->xMov, Man->yMov);
+  if (WorldHeight(world, world->nodeX[Man->cur], world->nodeZ[Man->cur]) <
+      WorldHeight(world, world->nodeX[next], world->nodeZ[next]))
+    game->ghostRate=slowGhostRate;
+  else
+    game->ghostRate=initialGhostRate;
+}
+
+/* stop pacmans movement */
+void stopPacman(GameState *game) {
+  game->Man.xMov = 0;
+  game->Man.yMov = 0;
+}
+
+/************ SCORING ROUTINES ***************/
+
+/* adding scores if pacman hits a dot or ppill */
+void addScores(GameState *game) {
+  const int n = game->Man.cur;
+  const unsigned long long bit = 1ULL << (n & 63);
+  unsigned long long *dots = &game->bits[n >> 6];
+  unsigned long long *ppills = &game->bits[game->numBitWords + (n >> 6)];
+
+  if (*dots & bit) {
+    // add score
+    game->score = game->score + dotScore;
+    *dots &= ~bit;
+    // decrease the number of dots
+    game->numDots--;
+    game->events |= GAME_EVENT_DOT;
+  }
+
+  if (*ppills & bit) {
+    // add score
+    game->score = game->score + ppillScore;
+    *ppills &= ~bit;
+    game->numDots--;
+    game->events |= GAME_EVENT_PPILL;
+  }
+
+  // check if the game ended
+  if (game->numDots < 1) {
+    returnToMenu(game, 1);
+  }
+}
+
+/* pacman meets a ghost - two lookups in the occupancy bitset */
+void checkCollision(GameState *game) {
+  const World *world = game->world;
+  Pacman *Man = &game->Man;
+  int dir = MazeDirection(Man->xMov, Man->yMov);
+  // the node pacman is moving to, if it can move at all
+  int next = (world->dirs[Man->cur] & dir) ?
+    MazeNeighbor(world, Man->cur, Man->xMov, Man->yMov) : -1;
+
+  //collision when a ghost is on pacmans node
+  //or on the node pacman is moving to
+  if (GameGhostAt(game, Man->cur) || ((next >= 0) && GameGhostAt(game, next)))
+    returnToMenu(game, -1);
+}
+
+/* return to main menu when game is won or over */
+void returnToMenu(GameState *game, int win) {
+  game->gameStart = 0;
+  game->gameWin = win;
+  game->events |= (win > 0) ? GAME_EVENT_WIN : GAME_EVENT_LOSE;
+}
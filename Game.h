@@ -0,0 +1,309 @@
+#ifndef Game_h
+#define Game_h
+
+/*
+ Headless game simulation for pacman.
+
+ Everything that decides how the game plays - the fractal world, the
+ maze built on top of it, pacman, the ghosts and the scoring - lives
+ here and never touches OpenGL or GLUT. The world is built once by
+ WorldCreate and is read-only afterwards. All the mutable parts of a
+ game sit in a GameState, which is advanced by GameStep one fixed
+ tick of GameTickSeconds at a time. The same inputs on the same world
+ always give the same game, however fast the caller runs the ticks.
+
+ The GLUT front end in Pacman.c owns one World and one GameState,
+ feeds keyboard input into GameStep and draws whatever the state
+ says. Anything else (bots, regression runs) can drive GameStep in a
+ tight loop without a window.
+
+ A GameState is plain data in one block - the fixed fields followed
+ by the dot and powerpill bitsets - so GameCopy and GameClone are a
+ single memcpy, cheap enough to snapshot a game every tick.
+ */
+
+#include <stddef.h>
+
+#include "Random.h"
+
+/************ WORLD CONSTANTS ***************/
+
+/* size of the one edge of the grid - in pixels, chosen at startup */
+static const int defaultGridSize = 256;
+static const int minGridSize = 64;
+static const int maxGridSize = 16384;
+
+/* distance between two parallel paths */
+static const int DistPaths = 10;
+
+/* the simulation always advances in steps of GameTickSeconds */
+static const int GameTicksPerSecond = 60;
+static const float GameTickSeconds = 1.0f / GameTicksPerSecond;
+
+/* number of ghosts in a game, unless asked for more */
+static const int defaultNumGhosts = 4;
+static const int maxNumGhosts = 65536;
+
+/* ghost colours - red, cyan, orange and pink, in turn */
+static const int numGhostColours = 4;
+static const float ghostColours[numGhostColours][3] = {
+  { 1., 0., 0. }, { 0., 1., 1. }, { 1., 0.5, 0. }, { 1., 0.5, 0.5 }
+};
+
+/* ghosts pick a new random direction after this many nodes */
+static const int ghostRandomTime = 5;
+
+/* ghost speed relative to pacman, slower while pacman goes uphill */
+static const float slowGhostRate = 1.;
+static const float initialGhostRate = 2.;
+
+/* scoring */
+static const int dotScore = 10;
+static const int ppillScore = 100;
+
+/* events reported by GameStep */
+#define GAME_EVENT_DOT   1	/* pacman ate a dot */
+#define GAME_EVENT_PPILL 2	/* pacman ate a powerpill */
+#define GAME_EVENT_WIN   4	/* all dots eaten */
+#define GAME_EVENT_LOSE  8	/* pacman met a ghost */
+
+/************ MAZE GRAPH ***************/
+
+/*
+  The maze is a graph over the nodes of a nodesPerLine x nodesPerLine
+  grid laid over the terrain, node n = i * nodesPerLine + j for the
+  node in column i (along x), row j (along z). Everything about a node
+  lives in flat arrays indexed by n, and moves are a 4 bit mask per
+  node - the neighbor in a direction is found by arithmetic on n, so
+  following the maze never chases a pointer.
+*/
+#define MAZE_LEFT  1	/* -x */
+#define MAZE_RIGHT 2	/* +x */
+#define MAZE_UP    4	/* +z */
+#define MAZE_DOWN  8	/* -z */
+
+/*
+  The terrain and the maze on top of it, built once per game. Both
+  grids live in heap blocks, row by row along x:
+  heightMap[x * gridSize + z] and node n = i * nodesPerLine + j.
+*/
+typedef struct world {
+  unsigned long seed;
+  int gridSize;
+  int nodesPerLine;
+  float *heightMap;
+
+  /* height thresholds for snow and water */
+  float snowThreshold;
+  float waterThreshold;
+
+  /* the maze graph - positions, open directions and, in compressed
+     sparse rows, the neighbors of node n in adj[adjStart[n]] up to
+     adj[adjStart[n+1]], in the order left, right, up, down */
+  int numNodes;
+  int *nodeX;
+  int *nodeZ;
+  unsigned char *dirs;
+  int *adjStart;
+  int *adj;
+
+  /* where the dots and powerpills start */
+  char *dot;
+  char *ppill;
+
+  /* connected regions of the maze - component[n] is the region of
+     node n, -1 out of the game, and each region knows how many nodes
+     and starting dots it holds */
+  int *component;
+  int numComponents;
+  int *componentNodes;
+  int *componentDots;
+
+  int pacmanStart;
+  int startX;
+  int startZ;
+  int numDots;
+} World;
+
+/************ GAME OBJECTS *********************/
+
+/* Represents pacman. */
+typedef struct pacman {
+  int alive;
+  int xMov;
+  int yMov;
+  int cur;		/* node it last reached */
+} Pacman;
+
+/*
+  Everything that changes while a game is played. It is allocated by
+  GameCreate with GameSize(world, numGhosts) bytes, room for the
+  bitsets and the ghosts at the end, and holds no pointers into itself.
+
+  The ghosts are kept as a structure of arrays after the bitsets, one
+  array per field, so a tick walks each field of every ghost in turn:
+    int cur[numGhosts]			node it last reached
+    int step[numGhosts]			added to cur at its next node
+    unsigned char dir[numGhosts]	MAZE_* bit it moves in, 0 standing
+    unsigned char timer[numGhosts]	nodes left before it turns at random
+    unsigned char colour[numGhosts]	row of ghostColours
+*/
+typedef struct gameState {
+  const World *world;
+
+  Pacman Man;
+  int numGhosts;
+
+  /* dots and powerpills left - the popcount of the bitsets */
+  int numDots;
+  int score;
+
+  /* distance travelled towards the next node */
+  float gPacmanTimer;
+  float gGhostTimer;
+  float ghostRate;
+
+  /* direction requested by the player, applied at the next node */
+  int pacmanNewX;
+  int pacmanNewY;
+
+  int chase;		/* 1 when ghosts hunt pacman instead of wandering */
+  int gameStart;	/* 1 while a game is being played */
+  int gameWin;		/* 1 won, -1 lost, 0 not finished */
+  int events;		/* GAME_EVENT_* flags raised by the last step */
+  int tick;		/* steps taken since the last reset */
+
+  /* where the ghosts' random turns come from, reset with the game */
+  Random ghostRandom;
+
+  /* one bit per node, numBitWords words of dots, as many of
+     powerpills and as many marking the nodes ghosts are on, then
+     the ghost arrays */
+  int numBitWords;
+  unsigned long long bits[];
+} GameState;
+
+/* Player input for a single step - (0, 0) keeps the current plan. */
+typedef struct gameInput {
+  int xMov;
+  int yMov;
+  int start;		/* 1 starts a game, as GameStart does */
+} GameInput;
+
+/************ FUNCTION PROTOTYPES ***************/
+
+/* world creation */
+void WorldCreate(World *world, unsigned long seed, int gridSize);
+void WorldFree(World *world);
+
+/* the stages of WorldCreate, in order - public so each can be timed */
+void WorldAllocate(World *world, unsigned long seed, int gridSize);
+void SetHeightMap(World *world);
+void SetThresholds(World *world);
+void createAdjacencyList(World *world);
+
+/* height of the terrain at pixel (x, z) */
+static inline float WorldHeight(const World *world, int x, int z)
+{
+  return world->heightMap[x * world->gridSize + z];
+}
+
+/* the node in column i, row j of the maze */
+static inline int WorldNode(const World *world, int i, int j)
+{
+  return i * world->nodesPerLine + j;
+}
+
+/* can one node be reached from the other */
+static inline int WorldReachable(const World *world, int from, int to)
+{
+  return (world->component[from] >= 0) && (world->component[from] == world->component[to]);
+}
+
+/* dots and powerpills the region of node n starts with */
+static inline int WorldRegionDots(const World *world, int n)
+{
+  return (world->component[n] >= 0) ? world->componentDots[world->component[n]] : 0;
+}
+
+/* the MAZE_* bit of a move, 0 when standing still */
+static inline int MazeDirection(int xMov, int yMov)
+{
+  return (xMov < 0) ? MAZE_LEFT : (xMov > 0) ? MAZE_RIGHT :
+    (yMov > 0) ? MAZE_UP : (yMov < 0) ? MAZE_DOWN : 0;
+}
+
+/* the node one step from node in the direction of a move */
+static inline int MazeNeighbor(const World *world, int node, int xMov, int yMov)
+{
+  return node + xMov * world->nodesPerLine + yMov;
+}
+
+/* the move along x and z of a MAZE_* bit */
+static inline int MazeMoveX(int dir)
+{
+  return ((dir >> 1) & 1) - (dir & 1);
+}
+
+static inline int MazeMoveZ(int dir)
+{
+  return ((dir >> 2) & 1) - ((dir >> 3) & 1);
+}
+
+/* game control */
+GameState *GameCreate(const World *world, int numGhosts);
+size_t GameSize(const World *world, int numGhosts);
+void GameReset(GameState *game);
+void GameFree(GameState *game);
+void GameStart(GameState *game);
+int GameStep(GameState *game, const GameInput *input);
+
+/* snapshots - to must have been created on the same world with the
+   same number of ghosts, as GameCopy copies GameSize bytes */
+void GameCopy(GameState *to, const GameState *from);
+GameState *GameClone(const GameState *game);
+
+/* dots and powerpills still on node n */
+static inline int GameDot(const GameState *game, int n)
+{
+  return (game->bits[n >> 6] >> (n & 63)) & 1;
+}
+
+static inline int GamePowerpill(const GameState *game, int n)
+{
+  return (game->bits[game->numBitWords + (n >> 6)] >> (n & 63)) & 1;
+}
+
+/* is any ghost on node n */
+static inline int GameGhostAt(const GameState *game, int n)
+{
+  return (game->bits[2 * game->numBitWords + (n >> 6)] >> (n & 63)) & 1;
+}
+
+/* count the dots and powerpills left from the bitsets */
+int GameCountDots(const GameState *game);
+
+/* a hash of everything that decides how the game goes on */
+unsigned long long GameChecksum(const GameState *game);
+
+/* the ghost arrays, read only - see GameState for the layout */
+static inline const int *GameGhostNodes(const GameState *game)
+{
+  return (const int *) (game->bits + 3 * game->numBitWords);
+}
+
+static inline const unsigned char *GameGhostDirs(const GameState *game)
+{
+  return (const unsigned char *) (GameGhostNodes(game) + 2 * game->numGhosts);
+}
+
+static inline const unsigned char *GameGhostColours(const GameState *game)
+{
+  return GameGhostDirs(game) + 2 * game->numGhosts;
+}
+
+/* where objects are between their nodes */
+void GamePacmanPosition(const GameState *game, float *x, float *z);
+void GameGhostPosition(const GameState *game, int ghost, float *x, float *z);
+
+#endif
@@ -0,0 +1,129 @@
+/************ HEADERS ***************/
+
+/* Ordinary C stuff */
+#include <stdio.h>
+#include <string.h>
+
+/* GL headers - with the prototypes for queries */
+#define GL_GLEXT_PROTOTYPES
+#include </usr/include/GL/gl.h>
+
+#include "GpuTimer.h"
+#include "Profile.h"
+
+/************ GLOBALS AND DEFINES ***************/
+
+/* the pool, a query for every phase of the last gpuTimerLatency frames */
+static GLuint gQueries[gpuTimerLatency][PROFILE_PHASES];
+
+/* the profile frame each slot was issued in, and which of its queries ran */
+static long gSlotFrame[gpuTimerLatency];
+static unsigned char gIssued[gpuTimerLatency][PROFILE_PHASES];
+
+/* the slot of the current frame, and the phase being timed, -1 for none */
+static int gSlot = 0;
+static int gActive = -1;
+static int gCreated = 0;
+
+/************ FUNCTION PROTOTYPES ***************/
+
+int timerQueriesAvailable(void);
+void collectSlot(int slot, int wait);
+
+/************ QUERY POOL ***************/
+
+/* GL_TIME_ELAPSED queries are core from OpenGL 3.3, an extension before */
+int timerQueriesAvailable(void)
+{
+  const char *version = (const char *) glGetString(GL_VERSION);
+  const char *extensions = (const char *) glGetString(GL_EXTENSIONS);
+  int major = 0, minor = 0;
+
+  if ((version != NULL) && (sscanf(version, "%d.%d", &major, &minor) == 2) &&
+      ((major > 3) || ((major == 3) && (minor >= 3))))
+    return 1;
+  return (extensions != NULL) && (strstr(extensions, "GL_ARB_timer_query") != NULL);
+}
+
+int GpuTimerCreate(void)
+{
+  if (!timerQueriesAvailable())
+    return 0;
+
+  glGenQueries(gpuTimerLatency * PROFILE_PHASES, &gQueries[0][0]);
+  memset(gIssued, 0, sizeof(gIssued));
+  gSlot = 0;
+  gSlotFrame[gSlot] = ProfileFrameNumber();
+  gActive = -1;
+  gCreated = 1;
+  return 1;
+}
+
+void GpuTimerFree(void)
+{
+  if (!gCreated)
+    return;
+  glDeleteQueries(gpuTimerLatency * PROFILE_PHASES, &gQueries[0][0]);
+  gCreated = 0;
+}
+
+/* report the queries of a slot - without wait, only those that are done */
+void collectSlot(int slot, int wait)
+{
+  for (int p = 0; p < PROFILE_PHASES; p++) {
+    GLuint available = 1;
+    GLuint64 elapsed;
+
+    if (!gIssued[slot][p])
+      continue;
+    gIssued[slot][p] = 0;
+    if (!wait)
+      glGetQueryObjectuiv(gQueries[slot][p], GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available)
+      continue;
+    glGetQueryObjectui64v(gQueries[slot][p], GL_QUERY_RESULT, &elapsed);
+    ProfileGpuTime(gSlotFrame[slot], p, elapsed * 1e-9f);
+  }
+}
+
+void GpuTimerNextFrame(void)
+{
+  if (!gCreated)
+    return;
+
+  // a pass left open would make every later query fail
+  if (gActive >= 0) {
+    glEndQuery(GL_TIME_ELAPSED);
+    gActive = -1;
+  }
+  gSlot = (gSlot + 1) % gpuTimerLatency;
+  collectSlot(gSlot, 0);
+  gSlotFrame[gSlot] = ProfileFrameNumber();
+}
+
+void GpuTimerFlush(void)
+{
+  if (!gCreated)
+    return;
+  for (int slot = 0; slot < gpuTimerLatency; slot++)
+    collectSlot(slot, 1);
+}
+
+/************ TIMING ***************/
+
+void GpuTimerBegin(int phase)
+{
+  if (!gCreated || (gActive >= 0))
+    return;
+  glBeginQuery(GL_TIME_ELAPSED, gQueries[gSlot][phase]);
+  gIssued[gSlot][phase] = 1;
+  gActive = phase;
+}
+
+void GpuTimerEnd(int phase)
+{
+  if (gActive != phase)
+    return;
+  glEndQuery(GL_TIME_ELAPSED);
+  gActive = -1;
+}
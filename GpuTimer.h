@@ -0,0 +1,41 @@
+#ifndef GpuTimer_h
+#define GpuTimer_h
+
+/*
+ GPU time of each drawing pass.
+
+ GpuTimerBegin and GpuTimerEnd put a GL_TIME_ELAPSED query around a
+ pass, one query object per pass and frame from a pool that covers
+ gpuTimerLatency frames. A result is only read when its query comes
+ round again, that many frames later, by which time the GPU has long
+ finished with it - asking straight away would stall the CPU until the
+ pipeline drains. Results go to ProfileGpuTime against the frame they
+ were measured in, next to its CPU times; one still not available
+ then is dropped rather than waited for.
+
+ Queries can not nest, so only one pass is timed at a time. Without
+ timer queries (OpenGL before 3.3 and no GL_ARB_timer_query)
+ GpuTimerCreate returns 0 and the other calls do nothing, leaving the
+ profile with CPU times only.
+ */
+
+/* frames between issuing a query and reading it back */
+#define gpuTimerLatency 4
+
+/* set up the query pool for the current context - 0 if there are no timer queries */
+int GpuTimerCreate(void);
+void GpuTimerFree(void);
+
+/* move on to the queries of the frame ProfileNextFrame just started,
+   reading back the ones issued gpuTimerLatency frames ago */
+void GpuTimerNextFrame(void);
+
+/* time a profile phase on the GPU */
+void GpuTimerBegin(int phase);
+void GpuTimerEnd(int phase);
+
+/* wait for every query issued so far and report it, for callers that
+   have just called glFinish anyway */
+void GpuTimerFlush(void);
+
+#endif
@@ -0,0 +1,125 @@
+/************ HEADERS ***************/
+
+/* Ordinary C stuff */
+#include <stdio.h>
+#include <string.h>
+
+/* EGL and GL headers - with the prototypes for framebuffer objects */
+#define GL_GLEXT_PROTOTYPES
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include </usr/include/GL/gl.h>
+
+#include "Offscreen.h"
+
+/************ GLOBALS AND DEFINES ***************/
+
+static EGLDisplay gDisplay = EGL_NO_DISPLAY;
+static EGLContext gContext = EGL_NO_CONTEXT;
+
+/* the framebuffer drawn into, its colour and depth renderbuffers */
+static GLuint gFramebuffer = 0;
+static GLuint gRenderbuffers[2] = { 0, 0 };
+static int gWidth = 0;
+static int gHeight = 0;
+
+/************ FUNCTION PROTOTYPES ***************/
+
+int createContext(void);
+
+/************ CONTEXT ***************/
+
+/* a compatibility context on the surfaceless platform - 0 on failure */
+int createContext(void)
+{
+  const EGLint attributes[] = {
+    EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_COMPATIBILITY_PROFILE_BIT,
+    EGL_NONE
+  };
+  PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+    (PFNEGLGETPLATFORMDISPLAYEXTPROC) eglGetProcAddress("eglGetPlatformDisplayEXT");
+  const char *extensions;
+  EGLint major, minor;
+
+  if (getPlatformDisplay == NULL) {
+    fprintf(stderr, "EGL has no eglGetPlatformDisplayEXT\n");
+    return 0;
+  }
+  gDisplay = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+  if ((gDisplay == EGL_NO_DISPLAY) || !eglInitialize(gDisplay, &major, &minor)) {
+    fprintf(stderr, "No surfaceless EGL display\n");
+    gDisplay = EGL_NO_DISPLAY;
+    return 0;
+  }
+
+  // without a config there is no surface, the framebuffer object is all we draw to
+  extensions = eglQueryString(gDisplay, EGL_EXTENSIONS);
+  if ((extensions == NULL) || (strstr(extensions, "EGL_KHR_no_config_context") == NULL) ||
+      !eglBindAPI(EGL_OPENGL_API)) {
+    fprintf(stderr, "EGL %d.%d cannot make a desktop GL context without a surface\n", major, minor);
+    return 0;
+  }
+  gContext = eglCreateContext(gDisplay, EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT, attributes);
+  if ((gContext == EGL_NO_CONTEXT) ||
+      !eglMakeCurrent(gDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, gContext)) {
+    fprintf(stderr, "Could not make an EGL context current\n");
+    return 0;
+  }
+  return 1;
+}
+
+/************ FRAMEBUFFER ***************/
+
+int OffscreenCreate(int width, int height)
+{
+  if (!createContext()) {
+    OffscreenFree();
+    return 0;
+  }
+
+  glGenFramebuffers(1, &gFramebuffer);
+  glBindFramebuffer(GL_FRAMEBUFFER, gFramebuffer);
+  glGenRenderbuffers(2, gRenderbuffers);
+
+  glBindRenderbuffer(GL_RENDERBUFFER, gRenderbuffers[0]);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, gRenderbuffers[0]);
+
+  glBindRenderbuffer(GL_RENDERBUFFER, gRenderbuffers[1]);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, gRenderbuffers[1]);
+
+  if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+    fprintf(stderr, "The offscreen framebuffer is incomplete\n");
+    OffscreenFree();
+    return 0;
+  }
+
+  gWidth = width;
+  gHeight = height;
+  glViewport(0, 0, width, height);
+  return 1;
+}
+
+void OffscreenRead(unsigned char *pixels)
+{
+  glReadPixels(0, 0, gWidth, gHeight, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+}
+
+void OffscreenFree(void)
+{
+  if (gContext != EGL_NO_CONTEXT) {
+    if (gFramebuffer != 0) {
+      glDeleteRenderbuffers(2, gRenderbuffers);
+      glDeleteFramebuffers(1, &gFramebuffer);
+      gFramebuffer = 0;
+    }
+    eglMakeCurrent(gDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    eglDestroyContext(gDisplay, gContext);
+    gContext = EGL_NO_CONTEXT;
+  }
+  if (gDisplay != EGL_NO_DISPLAY) {
+    eglTerminate(gDisplay);
+    gDisplay = EGL_NO_DISPLAY;
+  }
+}
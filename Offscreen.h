@@ -0,0 +1,23 @@
+#ifndef Offscreen_h
+#define Offscreen_h
+
+/*
+ Offscreen OpenGL for pacman, without a window or a display.
+
+ OffscreenCreate asks EGL for Mesa's surfaceless platform, makes a
+ compatibility profile context current on it and binds a framebuffer
+ object of the given size, with a colour and a depth renderbuffer, as
+ the target of every draw. On a box with no GPU Mesa renders with
+ llvmpipe, so the same drawing code the window uses can be run and
+ timed anywhere - the render benchmark in Pacman.c is built on it.
+ */
+
+/* a context drawing into a width x height framebuffer - 0 on failure */
+int OffscreenCreate(int width, int height);
+
+/* read the colour buffer back, 4 bytes a pixel, bottom row first */
+void OffscreenRead(unsigned char *pixels);
+
+void OffscreenFree(void);
+
+#endif
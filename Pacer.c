@@ -0,0 +1,132 @@
+/************ HEADERS ***************/
+
+/* Ordinary C stuff */
+#include <stdio.h>
+#include <errno.h>
+#include <math.h>
+#include <time.h>
+
+#include "Pacer.h"
+#include "Timer.h"
+
+#ifdef WINDOWS
+#include <Windows.h>
+#endif
+
+/************ GLOBALS AND DEFINES ***************/
+
+/* the target rate, and when the current frame is due */
+static float gRate = 60.f;
+static double gDeadline = 0.;
+
+/* whether the swap paces the frames, and how long swaps have taken */
+static int gVsync = 0;
+static float gSwapAverage = 0.f;
+static long gSwapFrames = 0;
+
+/* swaps measured before deciding they do not wait for the blank */
+static const int vsyncCheckFrames = 60;
+
+/* frames in a row that changed nothing */
+static int gIdleFrames = 0;
+
+/************ FUNCTION PROTOTYPES ***************/
+
+float frameInterval(void);
+void sleepUntil(double deadline);
+
+/************ SCHEDULE ***************/
+
+void PacerStart(float rate)
+{
+  gRate = (rate > 0.f) ? rate : 0.f;
+  gDeadline = GetTimeInSeconds();
+  gIdleFrames = 0;
+}
+
+void PacerSetVsync(int vsync)
+{
+  gVsync = vsync;
+  gSwapAverage = 0.f;
+  gSwapFrames = 0;
+}
+
+/* seconds between frames as things stand, 0 for no wait */
+float frameInterval(void)
+{
+  if (PacerLowPower())
+    return 1.f / lowPowerRate;
+  if (gVsync || (gRate == 0.f))
+    return 0.f;
+  return 1.f / gRate;
+}
+
+int PacerFrameDone(int active, float swapSeconds)
+{
+  const double now = GetTimeInSeconds();
+  float interval;
+
+  gIdleFrames = active ? 0 : gIdleFrames + 1;
+
+  // a swap that returns at once is not waiting for the vertical blank
+  if (gVsync && active && (gRate > 0.f)) {
+    gSwapFrames++;
+    gSwapAverage += (swapSeconds - gSwapAverage) / gSwapFrames;
+    if ((gSwapFrames >= vsyncCheckFrames) && (gSwapAverage < 0.1f / gRate)) {
+      fprintf(stderr, "Swaps do not wait for the vertical blank, pacing by sleeping instead\n");
+      gVsync = 0;
+    }
+  }
+
+  interval = frameInterval();
+  gDeadline += interval;
+  if (gDeadline < now - interval)
+    gDeadline = now;
+  return (gDeadline > now) ? (int) floor((gDeadline - now) * 1e3) : 0;
+}
+
+void PacerWake(void)
+{
+  gIdleFrames = 0;
+  gDeadline = GetTimeInSeconds();
+}
+
+int PacerLowPower(void)
+{
+  return gIdleFrames >= idleFramesBeforeLowPower;
+}
+
+/************ SLEEPING ***************/
+
+void PacerWait(void)
+{
+  sleepUntil(gDeadline);
+}
+
+#ifdef WINDOWS
+
+/* Sleep only counts milliseconds, the last one is left to chance */
+void sleepUntil(double deadline)
+{
+  const double left = deadline - GetTimeInSeconds();
+
+  if (left > 0.001)
+    Sleep((DWORD) (left * 1e3));
+}
+
+#else
+
+/* an absolute deadline, so a signal waking us early only sleeps again */
+void sleepUntil(double deadline)
+{
+  struct timespec until;
+
+  if (deadline <= GetTimeInSeconds())
+    return;
+  until.tv_sec = (time_t) deadline;
+  until.tv_nsec = (long) ((deadline - until.tv_sec) * 1e9);
+  while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &until, NULL) == EINTR)
+    ;
+}
+
+#endif
@@ -0,0 +1,56 @@
+#ifndef Pacer_h
+#define Pacer_h
+
+/*
+ Frame pacing for the window.
+
+ Instead of drawing from an idle callback as often as GLUT will call
+ it, the front end asks the pacer when the next frame is due and lets
+ GLUT wait for it in glutTimerFunc, where the process sleeps and still
+ wakes up for keyboard and window events. GLUT timers only count whole
+ milliseconds, so the timer is set a little early and PacerWait sleeps
+ the rest of the way to the deadline on the monotonic clock.
+
+ Deadlines are kept one interval apart at the target rate, so an
+ occasional late frame does not slow the average down; a frame that
+ falls more than an interval behind starts the schedule again rather
+ than bursting to catch up.
+
+ When the swap waits for the vertical blank, the swap already paces
+ the frames and sleeping as well would only miss blanks, so the pacer
+ leaves it to the swap - until the swaps turn out not to block after
+ all, as when a driver ignores the swap interval, and it goes back to
+ sleeping.
+
+ A frame in which nothing on the screen changed counts as idle. After
+ a run of idle frames the pacer drops to lowPowerRate and the front
+ end stops redrawing, until PacerWake says something happened.
+ */
+
+/* frames a second while nothing changes */
+static const float lowPowerRate = 5.f;
+
+/* idle frames before the pacer slows down, half a second at 60Hz */
+static const int idleFramesBeforeLowPower = 30;
+
+/* frames a second to aim for, 0 for as many as can be drawn */
+void PacerStart(float rate);
+
+/* 1 if the swap interval was set to wait for the vertical blank */
+void PacerSetVsync(int vsync);
+
+/* sleep until the current frame is due */
+void PacerWait(void);
+
+/* a frame is finished - active is 0 if nothing on the screen changed,
+   swapSeconds how long its buffer swap took. Returns the whole
+   milliseconds until the next frame is due, for glutTimerFunc */
+int PacerFrameDone(int active, float swapSeconds);
+
+/* back to the full rate, the next frame due now */
+void PacerWake(void);
+
+/* 1 while the pacer is idling at lowPowerRate */
+int PacerLowPower(void);
+
+#endif
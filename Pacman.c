@@ -5,11 +5,13 @@
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <iostream>
 #include <algorithm>
 
-/* GLUT headers */
+/* GLUT headers, and GLX for the swap interval */
 #include </usr/include/GL/glut.h>
+#include </usr/include/GL/glx.h>
 
 /* Maths library - remember to use -lm if building with GCC */
 #include <math.h>
@@ -20,6 +22,43 @@
 /* Our very own timer routines, used to measure frame rate, etc */
 #include "Timer.h"
 
+/* The game itself - world, maze, pacman and ghosts */
+#include "Game.h"
+
+/* Instanced dot drawing */
+#include "Dots.h"
+
+/* Terrain vertex and index buffers */
+#include "Terrain.h"
+
+/* View frustum culling */
+#include "Frustum.h"
+
+/* Shortest distances across the maze */
+#include "Distance.h"
+
+/* Recording and replaying games */
+#include "Replay.h"
+
+/* Many games at once */
+#include "Batch.h"
+
+/* Pacman playing on its own */
+#include "Autopilot.h"
+
+/* Worker threads for world generation */
+#include "ThreadPool.h"
+
+/* Drawing without a window */
+#include "Offscreen.h"
+
+/* Where the time of a frame goes */
+#include "Profile.h"
+#include "GpuTimer.h"
+
+/* When the next frame is due */
+#include "Pacer.h"
+
 /************ GLOBALS AND DEFINES ***************/
 
 /* the name of application */
@@ -36,7 +75,6 @@ static const float PiTimesTwo = 6.283185307179586476925286766559f;
 static const float PiOverTwo = 1.5707963267948966192313216916398f;
 
 /* the id number of our openGL display list */
-static GLuint gTerrainList = (GLuint)(-1);
 static GLuint gPacman = (GLuint)(-1);
 static GLuint gLQGhost = (GLuint)(-1);
 static GLuint gMQGhost = (GLuint)(-1);
@@ -47,13 +85,15 @@ static GLuint gHQFruit = (GLuint)(-1);
 /* spline objects */
 static GLUnurbsObj *theGhostNurb;
 static GLUnurbsObj *theFruitNurb;
+
+/* sphere object for pacman, the dots and the ghosts' eyes */
+static GLUquadricObj *theSphere;
 static const int hqGhostThreshold = 5;
 static const int mqGhostThreshold = 15;
 
-/* size of the one edge of the grid - in pixels */
-static const int gridSize = 256;
-static const int xCenter = gridSize / 2;
-static const int yCenter = gridSize / 4;
+/* centre of the grid, used by the 2d cameras - set once the world is built */
+static int xCenter = defaultGridSize / 2;
+static int yCenter = defaultGridSize / 4;
 
 /* projection constants */
 static const int feet = 10;
@@ -62,12 +102,9 @@ static int camHeight = camDist;
 static int projection = 1;
 static const int totalProjections = 3;
 static int projectionAngle = 0;
+static const char *projectionNames[totalProjections] = { "first_person", "top", "side" };
 
 /* game constants */
-static int gameStart = 0;
-static int gameWin = 0;
-static int pacmanNewX = 0;
-static int pacmanNewY = 0;
 static char scoreBuf[10];
 static char titleBuf[40] = "Pacman";
 static char enterBuf[40] = "Press 's' to start";
@@ -78,92 +115,98 @@ static char winBuf[40] = "YOU WON!!";
 
 /* our projection settings - we use these in our projection transformation */
 static const float NearZPlane = 0.01;
-static const float FarZPlane = float (gridSize*2);
+static float FarZPlane = float (defaultGridSize*2);
 static const float FieldOfViewInDegrees = 90.;
 
-/* our animation and timing system */
-static float gPacmanTimer = 0.;
-static float gGhostTimer = 0.;
-static const float slowGhostRate = 1.;
-static const float initialGhostRate = 2.;
-static float ghostRate = initialGhostRate;
-static const int ghostRandomTime = 5;
-
-/* heightMap */
-static float heightMap[gridSize][gridSize];
-static float colorVector[3];
-
-/* height thresholds for snow and water */
-static float snowThreshold;
-static float waterThreshold;
-
-/* scoring */
-static int score = 0;
-static const int dotScore = 10;
-static const int ppillScore = 100;
-
-/************ ADJACENCY LIST REP ***************/
-
-typedef struct neighborList {
-  struct node *left;		//in -x direction
-  struct node *up;		//in z direction
-  struct node *right;		//in x direction
-  struct node *down;		//in -z direction
-} Neighbors;
-
-/* Represents a node. */
-typedef struct node {
-  int traversed;
-  int x;
-  int z;
-  int ingame;              // as a boolean 0-none 1-exists
-  int dot;                 // as a boolean 0-none 1-exists
-  int ppill;               // as a boolean 0-noce 1-exists
-  Neighbors nbor;
-  int numadj;
-  struct node *adj[4];
-} Node;
-
-/* distance between two parallel paths */
-static const int DistPaths = 10;
-static const int NodesPerLine = gridSize / DistPaths;
-
-/* memory allocation for nodes */
-static Node Nodes[NodesPerLine][NodesPerLine];
-static int startX;
-static int startZ;
-
-/************ GAME OBJECTS *********************/
-
-/* Represents a ghost. */
-typedef struct ghost {
-  int alive;
-  float r;
-  float g;
-  float b;           
-  int xMov;         
-  int yMov;    
-  int ghostTimer; 
-  Node* cur;
-} Ghost;
-
-/* Represents pacman. */
-typedef struct pacman {
-  int alive;          
-  int xMov;         
-  int yMov;     
-  Node* cur;
-} Pacman;
-
-/* memory allocation for objects. */
-static Ghost Ghosts[4];
-static Pacman Man;
-
-/* variables needed for ghost creation. */
-static int numDots = 0;
-static int xPos;
+/* the world and the game being played in it */
+static World gWorld;
+static GameState *gState;
+
+/* the game one tick ago, drawing blends from it towards gState */
+static GameState *gPreviousState;
+
+/* real time not yet simulated, and how far we are into the next tick */
+static float gTickAccumulator = 0.;
+static float gTickAlpha = 0.;
+
+/* never run more catch-up ticks than this in one frame */
+static const int maxTicksPerFrame = 15;
+
+/* command line options */
+static long gHeadlessTicks = 0;		/* -headless <ticks> */
+static int gThreads = 0;		/* -threads <n>, 0 for one per core */
+static int gGridSize = defaultGridSize;	/* -size <n>, edge of the map */
+static int gChase = 0;			/* -chase, ghosts hunt pacman */
+static int gNumGhosts = defaultNumGhosts;	/* -ghosts <n> */
+static unsigned long gSeed = 0;		/* -seed <n>, the clock if not given */
+static int gSeedGiven = 0;
+static const char *gRecordFile = NULL;	/* -record <file> */
+static const char *gReplayFile = NULL;	/* -replay <file> */
+static int gReplayFast = 0;		/* -fast, replay headless */
+static int gBatchGames = 0;		/* -batch <games> */
+static const char *gOutFile = NULL;	/* -out <file>, batch or render results */
+static int gRenderFrames = 0;		/* -renderbench <frames> */
+
+/* 1 while drawing into an offscreen framebuffer, with no GLUT window */
+static int gOffscreen = 0;
+
+/* -profile <file>, where the frame profile goes at exit - CSV if it
+   ends in .csv, a Chrome trace otherwise */
+static const char *gProfileFile = NULL;
+
+/* 1 while the frame profile is drawn over the scene, 'p' switches */
+static int gShowProfile = 0;
+
+static float gTargetRate = 60.f;	/* -fps <n>, 0 for as many as can be drawn */
+static int gVsyncOption = -1;		/* -vsync on|off, -1 leaves it to the driver */
+
+/* frames come from the newest timer set - older ones are ignored */
+static int gTimerGeneration = 0;
+
+/* 1 once something happened that the next frame has to show */
+static int gRedraw = 0;
+
+/* how long the last buffer swap took, which tells if it waits for vsync */
+static float gSwapSeconds = 0.f;
+
+/* the render benchmark draws this many frames before timing each camera */
+static const int renderWarmupFrames = 5;
+
+static int gAutopilot = 0;		/* -autopilot <ms>, search time a move */
+
+/* where the autopilot's rollouts in the window take their numbers */
+static Random gAutopilotRandom;
+
+/* a batch game nobody decides is called off after this many ticks */
+static const long batchMaxTicks = 1000000;
+
+/* the recording being played back, while gReplaying */
+static Replay gReplay;
+static int gReplaying = 0;
+static const char *gDistanceFile = NULL;	/* -distances <file> */
+
+/* node to node distances, numNodes is 0 unless asked for */
+static DistanceTable gDistances;
+
+/* terrain triangles drawn in the last frame */
+static int gTerrainTriangles = 0;
+
+/* what the last frame drew and culled */
+static CullCounts gCullChunks;
+static CullCounts gCullDots;
+static CullCounts gCullFruits;
+static CullCounts gCullGhosts;
+
+/* bounding sphere of the ghost and fruit models */
+static const float objectRadius = 9.;
+
+/* direction requested from the keyboard since the last update */
+static GameInput gInput;
+
+/* pacmans position, where the camera looks at */
+static float xPos;
 static float yPos;
-static int zPos;
+static float zPos;
 
 /************ FUNCTION PROTOTYPES ***************/
 
@@ -179,52 +222,57 @@ void InitialiseOpenGL(void);
 void InitialiseScene(void);
 
 /* Our per-frame updating and rendering */
-void UpdateFrame(void);
+int UpdateFrame(void);
+
+/* frame pacing */
+void frameTimer(int generation);
+void wakeFrames(void);
+void initialiseVsync(void);
+int setSwapInterval(int interval);
 
 /* projection manipulations */
 void projectionMenu(int value);
 void setFirstPersonProjection(void);
-void returnToMenu(int win);
 
-/* Fractal geometry */
-void SetHeightMap(void);
-void DivideGrid(int x, int y, float size, float c1, float c2, float c3, float c4);
-GLfloat* SetColor (float color_val, int x, int z);
-void SetThresholds(void);
+/* blending between simulation ticks */
+void interpolatePacman(float *x, float *z);
+void interpolateGhost(int ghost, float *x, float *z);
 
 /* Drawing creation */
 void renderBitmapString(float x, float y, void *font, char *string);
-void DrawTerrain(void);
+void DrawMenuText(void);
+void DrawProfileOverlay(void);
 void DrawPacman(void);
 void DrawFruit(void);
 void DrawGhost(void);
 void DrawDot(int quality);
 
-/* adjacency list creation */
-void createAdjacencyList(void);
-Node* findPacmanStartNode (int starterX, int starterZ);
-void traverseNeighbors(Node *node, int x, int y);
-void placePowerpill(int x, int y);
-
-/* ghost manipulations */
-void createGhosts(void);
-void randomize(Ghost* ghost);
-Node* findStartNode (int starterX, int starterZ);
-void checkStartDirection(Ghost* ghost);
-void updateGhosts(void);
-void checkGhostTimer(Ghost* ghost);
-
-/* pacman manipulations */
-void createPacman(void);
-void refreshPacman(void);
-void updatePacmanPosition(void);
-void updatePacmanMovement(void);
-void checkPacmanMovement(void);
-void stopPacman(void);
-
-/* scoring routines */
-void addScores(void);
-void checkCollision(void);
+/* running without a window */
+int RunHeadless(long ticks);
+int RunReplay(void);
+int RunBatch(int numGames);
+
+/* timing the drawing without a window */
+int RunRenderBench(int frames);
+void writeRenderStats(FILE *file, const char *measure, double *samples, int count);
+unsigned long long imageChecksum(const unsigned char *pixels, size_t size);
+
+/* recording */
+void finishRecording(void);
+
+/* profiling */
+void writeProfile(void);
+void beginPass(int phase);
+void endPass(int phase);
+
+/* autopilot */
+void printAutopilotStats(void);
+
+/* maze analysis */
+void PrepareDistances(const char *path);
+
+/* command line */
+void parseOptions(int *argc, char **argv);
 
 /************ INITIALISATION ROUTINES ***************/
 
@@ -269,7 +317,8 @@ void InitialiseGLUT(int argc, char **argv)
 void InitialiseOpenGL()
 {
   /* define the background, or "clear" colour, for our window  */
-  glutSetWindow (game_window);
+  if (!gOffscreen)
+    glutSetWindow (game_window);
   glClearColor(0.7f, 0.7f, 0.7f, 0.0f);
 
   /*
@@ -319,7 +368,6 @@ void InitialiseOpenGL()
 void InitialiseScene(void)
 {
   /* Create new lists, and store its ID number */
-  gTerrainList = glGenLists(1);
   gPacman = glGenLists(2);
   gLQGhost = glGenLists(3);
   gMQGhost = glGenLists(4);
@@ -328,9 +376,10 @@ void InitialiseScene(void)
   gHQFruit = glGenLists(7);
 
   // create terrain
-  glNewList(gTerrainList, GL_COMPILE);
-  DrawTerrain();
-  glEndList();
+  TerrainCreate(&gWorld);
+
+  // spheres come from GLU rather than GLUT, so they can be built offscreen
+  theSphere = gluNewQuadric();
 
   // create pacman
   glNewList(gPacman, GL_COMPILE);
@@ -383,6 +432,11 @@ void InitialiseScene(void)
   glNewList(gHQDot, GL_COMPILE);
   DrawDot(10);
   glEndList();
+
+  gluDeleteQuadric(theSphere);
+
+  /* and put one on every node that has one */
+  DotsCreate(gState, feet/4, gHQDot);
 }
 
 /************ GLUT CALLBACKS ***************/
@@ -390,7 +444,8 @@ void InitialiseScene(void)
 /* Called whenever the size of the window changes */
 void GameResize(int newWidth, int newHeight)
 {
-  glutSetWindow(game_window);
+  if (!gOffscreen)
+    glutSetWindow(game_window);
 
   /* instruct openGL to use the entirety of our window */
   glViewport(0, 0, newWidth, newHeight);
@@ -405,6 +460,8 @@ void GameResize(int newWidth, int newHeight)
 void GameKeyboardAction(unsigned char key, int mousex, int mousey)
 {
   unsigned char keytest = tolower(key);
+
+  wakeFrames();
   /* allow the user to quit with the keyboard */
   if (keytest == 'q') {
     glutDestroyWindow(game_window);
@@ -413,10 +470,11 @@ void GameKeyboardAction(unsigned char key, int mousex, int mousey)
   } else if (keytest == 'c') {
     projectionMenu((projection + 1) % totalProjections);
   } else if (keytest == 's') {
-    score = 0;
     projection = 0;
-    gameStart = 1;
-    gameWin = 0;
+    // started on the next tick, so a recording sees it
+    gInput.start = 1;
+  } else if (keytest == 'p') {
+    gShowProfile = !gShowProfile;
   }
 }
 
@@ -437,10 +495,10 @@ void GameSpecialKeyAction(int key, int x, int y) {
   }
 
   // using cos and sin to find out the x and y coordinates of current direction
-  pacmanNewX = sin(projectionAngle*M_PI/180);
-  pacmanNewY = cos(projectionAngle*M_PI/180);
+  gInput.xMov = sin(projectionAngle*M_PI/180);
+  gInput.yMov = cos(projectionAngle*M_PI/180);
 
-  glutPostRedisplay();
+  wakeFrames();
 }
 
 /*
@@ -449,17 +507,19 @@ void GameSpecialKeyAction(int key, int x, int y) {
 void GameDrawScene(void)
 {
   // clear the background
-  glutSetWindow(game_window);
+  if (!gOffscreen)
+    glutSetWindow(game_window);
   glClearColor(0.8, 0.8, 0.8, 0.0);
   glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
   glMatrixMode(GL_MODELVIEW);
 
   // set up projections
   glLoadIdentity();
+  const Pacman *Man = &gState->Man;
+
   // get pacmans coordinates
-  xPos = Man.cur->x + Man.xMov * gPacmanTimer;
-  zPos = Man.cur->z + Man.yMov * gPacmanTimer;
-  yPos =  (float) heightMap[xPos][zPos] + feet;
+  interpolatePacman(&xPos, &zPos);
+  yPos =  WorldHeight(&gWorld, (int) xPos, (int) zPos) + feet;
 
   if (projection == 0)
     // set a projection from pacmans perspective
@@ -471,14 +531,20 @@ void GameDrawScene(void)
 	       0.0, 0.0, 1.0);
   else
     // set up a projection from side
-    gluLookAt (xCenter, yCenter, gridSize + yCenter, 
+    gluLookAt (xCenter, yCenter, gWorld.gridSize + yCenter, 
 	       xCenter, yCenter, -1.0, 
 	       0.0, 1.0, 0.0);
 
+  // nothing outside the view of this camera is submitted
+  Frustum frustum;
+  FrustumFromGL(&frustum);
+
   // draw the terrain
   glPushMatrix();
   glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-  glCallList(gTerrainList);
+  beginPass(PROFILE_TERRAIN);
+  gTerrainTriangles = TerrainDraw(&frustum, &gCullChunks);
+  endPass(PROFILE_TERRAIN);
   glPopMatrix();
 
   // pacman
@@ -489,51 +555,58 @@ void GameDrawScene(void)
 
   // dots
   glColor3f (1., 1., 1.);
-  for (int i = 0; i < NodesPerLine; i++) {
-    for (int j = 0; j < NodesPerLine; j++) {
-      if (Nodes[i][j].dot > 0) {
-	glPushMatrix();
-	glTranslatef(Nodes[i][j].x, 
-		     (float) heightMap[Nodes[i][j].x][Nodes[i][j].z] 
-		     + (feet/4), 
-		     Nodes[i][j].z);
-	glCallList(gHQDot);
-	glPopMatrix();
-      }
-    }
-  }
+  beginPass(PROFILE_DOTS);
+  DotsDraw(&frustum, &gCullDots);
+  endPass(PROFILE_DOTS);
 	
   // fruits
+  beginPass(PROFILE_FRUITS);
   glColor3f (0.5, 1., 0.);
-  for (int i = 0; i < NodesPerLine; i += NodesPerLine - 1) {
-    for (int j = 0; j < NodesPerLine; j += NodesPerLine - 1) {
-      if (Nodes[i][j].ppill > 0) {
+  gCullFruits.drawn = gCullFruits.culled = 0;
+  const int lastNode = gWorld.nodesPerLine - 1;
+  for (int i = 0; i <= lastNode; i += lastNode) {
+    for (int j = 0; j <= lastNode; j += lastNode) {
+      if (GamePowerpill(gState, WorldNode(&gWorld, i, j))) {
+	const int node = WorldNode(&gWorld, i, j);
+	const int x = gWorld.nodeX[node], z = gWorld.nodeZ[node];
+	const float height = WorldHeight(&gWorld, x, z) + feet;
+	if (!FrustumSphere(&frustum, x, height, z, objectRadius)) {
+	  gCullFruits.culled++;
+	  continue;
+	}
+	gCullFruits.drawn++;
 	glPushMatrix();
-	glTranslatef(Nodes[i][j].x, 
-		     (float) heightMap[Nodes[i][j].x][Nodes[i][j].z] 
-		     + feet, 
-		     Nodes[i][j].z);
+	glTranslatef(x, height, z);
 	glCallList(gHQFruit);
 	glPopMatrix();
       }
     }
   }
+  endPass(PROFILE_FRUITS);
 
   // ghost
-  for(int i = 0; i < 4; i++) {
-    glPushMatrix();
-    glColor3f (Ghosts[i].r, Ghosts[i].g, Ghosts[i].b);
-    
+  beginPass(PROFILE_GHOSTS);
+  gCullGhosts.drawn = gCullGhosts.culled = 0;
+  for(int i = 0; i < gState->numGhosts; i++) {
+    const float *colour = ghostColours[GameGhostColours(gState)[i]];
+
     // get ghosts corrdinates
-    xPos = Ghosts[i].cur->x + Ghosts[i].xMov * gGhostTimer;
-    zPos = Ghosts[i].cur->z + Ghosts[i].yMov * gGhostTimer;
-    
-    glTranslatef(xPos, (float) heightMap[xPos][zPos] + feet, zPos);
+    interpolateGhost(i, &xPos, &zPos);
+    const float height = WorldHeight(&gWorld, (int) xPos, (int) zPos) + feet;
+    if (!FrustumSphere(&frustum, xPos, height, zPos, objectRadius)) {
+      gCullGhosts.culled++;
+      continue;
+    }
+    gCullGhosts.drawn++;
+
+    glPushMatrix();
+    glColor3fv(colour);
+    glTranslatef(xPos, height, zPos);
     
     // calculate its distance from pacman
-    static int xDist, zDist;
-    xDist = abs(Man.cur->x - xPos);
-    zDist = abs(Man.cur->z - zPos);
+    static float xDist, zDist;
+    xDist = fabs(gWorld.nodeX[Man->cur] - xPos);
+    zDist = fabs(gWorld.nodeZ[Man->cur] - zPos);
 
     if ((xDist < hqGhostThreshold) || (zDist < hqGhostThreshold))
       // if it is close enough, high quality drawing
@@ -547,6 +620,7 @@ void GameDrawScene(void)
 
     glPopMatrix();
   }
+  endPass(PROFILE_GHOSTS);
 
   //set orthographic projection for score and main menu
   glMatrixMode(GL_PROJECTION);
@@ -558,43 +632,14 @@ void GameDrawScene(void)
   glPushMatrix();
   glLoadIdentity();
 
-  // print score
-  sprintf(scoreBuf, "Score: %d", score);
-  glColor3f(1.0f, 1.0f, 1.0f);
-  renderBitmapString(10, 40, GLUT_BITMAP_HELVETICA_18,scoreBuf);
-
-  // main menu if game hasnt started
-  if (gameStart < 1) {
-    // stop movement
-    gPacmanTimer = 0.;
-    gGhostTimer = 0.;
-
-    glColor3f(1., 0., 0.);
-    if (gameWin > 0) {
-      // if game is won, print YOU WON
-      renderBitmapString(10, 20, GLUT_BITMAP_HELVETICA_18, winBuf);
-      glColor3f(1., 0., 0.);
-      renderBitmapString(10, 60, GLUT_BITMAP_HELVETICA_12, quitBuf);
-    }
-    else if (gameWin < 0) {
-      // if game is lost, print GAME OVER
-      renderBitmapString(10, 20, GLUT_BITMAP_HELVETICA_18, loseBuf);
-      glColor3f(1., 0., 0.);
-      renderBitmapString(10, 60, GLUT_BITMAP_HELVETICA_12, quitBuf);
-    }
-    else {
-      // if game hasnt started, welcome
-      renderBitmapString(10, 20, GLUT_BITMAP_HELVETICA_18,titleBuf);
-      glColor3f(1., 0., 0.);
-      renderBitmapString(10, 60, GLUT_BITMAP_HELVETICA_12, enterBuf);
-    }
-  } else {
-    // write PACMAN 3D if you are already in game
-    glColor3f(0.0f, 0.0f, 0.7f);
-    renderBitmapString(10,20,GLUT_BITMAP_HELVETICA_18,titleBuf); 
-    glColor3f(1., 0., 0.);
-    renderBitmapString(10, 60, GLUT_BITMAP_HELVETICA_12, cameraBuf);
+  // GLUT fonts need a GLUT window, offscreen frames go without text
+  beginPass(PROFILE_TEXT);
+  if (!gOffscreen) {
+    DrawMenuText();
+    if (gShowProfile)
+      DrawProfileOverlay();
   }
+  endPass(PROFILE_TEXT);
 
   glPopMatrix();
 
@@ -603,47 +648,178 @@ void GameDrawScene(void)
   glPopMatrix();
   glMatrixMode(GL_MODELVIEW);
 	
-  /* "double buffering" */
-  glutSwapBuffers();
+  /* "double buffering" - an offscreen framebuffer has a single buffer */
+  ProfileBegin(PROFILE_SWAP);
+  if (!gOffscreen) {
+    const double swapStart = GetTimeInSeconds();
+    glutSwapBuffers();
+    gSwapSeconds = GetTimeInSeconds() - swapStart;
+  }
+  ProfileEnd(PROFILE_SWAP);
 }
 
 /************ FRAME UPDATES ***************/
 
-/* Our main update function - called every time we go through our main loop */
-void UpdateFrame(void)
+/*
+  Our main update function - called for every frame the pacer schedules.
+  Returns 1 if the frame changed what is on the screen.
+*/
+int UpdateFrame(void)
 {
   /* our timing information */
   unsigned int fps;
-  float dt;
-
-  /* force another redraw, so we are always drawing as much as possible */
-  glutPostRedisplay();
-	
-  /* adjust our timer, which we might use for transforming our objects */
-  dt = GetPreviousFrameDeltaInSeconds();
-  dt = dt * (float) DistPaths;
-  gPacmanTimer += dt;
-  gGhostTimer += ghostRate * dt;
-
-  // update ghosts current node when timer goes DistPaths pixels
-  if (gGhostTimer > (float) DistPaths) {
-    gGhostTimer = 0.;
-    updateGhosts();
-  }
-
-  // update pacmans current node when timer goes DistPaths pixels
-  if (gPacmanTimer > (float) DistPaths) {
-    gPacmanTimer = 0.;
-    refreshPacman();
+  int ticks = 0;
+  int events = 0;
+  int tickEvents;
+  int active;
+
+  /* everything from here to the next update is one frame */
+  ProfileNextFrame();
+  GpuTimerNextFrame();
+
+  /* run as many fixed ticks as the real time since the last frame covers */
+  gTickAccumulator += GetPreviousFrameDeltaInSeconds();
+  // while no game runs, time spent idling owes no ticks - a game
+  // started now begins without a backlog to catch up on
+  if ((gState->gameStart < 1) && (gTickAccumulator > GameTickSeconds))
+    gTickAccumulator = GameTickSeconds;
+  while ((gTickAccumulator >= GameTickSeconds) && (ticks < maxTicksPerFrame)) {
+    // a replay steers until the tick its recording ended on
+    if (gReplaying && (gState->tick >= gReplay.ending.tick)) {
+      printf("%s\n", ReplayMatches(&gReplay, gState) ?
+	     "Replay matches the recording, over to you" : "Replay finished, over to you");
+      gReplaying = 0;
+    }
+    if (gReplaying)
+      ReplayNextInput(&gReplay, gState->tick, &gInput);
+    else if (gAutopilot) {
+      // the autopilot steers, the keyboard can still start a game
+      const int start = gInput.start;
+      AutopilotPolicy(gState, &gAutopilotRandom, &gInput);
+      gInput.start = start;
+    }
+    ReplayRecordInput(gState->tick, &gInput);
+
+    ProfileBegin(PROFILE_TICK);
+    GameCopy(gPreviousState, gState);
+    tickEvents = GameStep(gState, &gInput);
+    // a dot can only be eaten on the node pacman has just reached
+    if (tickEvents & GAME_EVENT_DOT)
+      DotsClear(gState->Man.cur);
+    ProfileEnd(PROFILE_TICK);
+    events |= tickEvents;
+    gInput.xMov = 0;
+    gInput.yMov = 0;
+    gInput.start = 0;
+    gTickAccumulator -= GameTickSeconds;
+    ticks++;
   }
-  // printf("gan: %d\n", (int) gPacmanTimer);
+  // too far behind to catch up, let the game slow down instead
+  if (ticks == maxTicksPerFrame)
+    gTickAccumulator = 0.;
+  gTickAlpha = gTickAccumulator / GameTickSeconds;
+
+  if (events & (GAME_EVENT_WIN | GAME_EVENT_LOSE))
+    // back to the menu, seen from above
+    projection = 1;
+
+  /* redraw while anything moves, and for a while after, until the pacer idles */
+  active = gRedraw || (gState->gameStart > 0) || gReplaying || (events != 0) || gShowProfile;
+  if (active || !PacerLowPower())
+    glutPostRedisplay();
+  gRedraw = 0;
 	
   /* timing information */
   if (ProcessTimer(&fps))
     {
       /* update our frame rate display */
-      printf("FPS: %d\n", fps);
+      FrameTimeStats stats;
+      GetFrameTimeStats(&stats);
+      printf("FPS: %d  frame ms min %.2f median %.2f p99 %.2f max %.2f  terrain triangles %d\n", fps,
+	     stats.min * 1000.f, stats.median * 1000.f,
+	     stats.p99 * 1000.f, stats.max * 1000.f, gTerrainTriangles);
+      printf("  drawn/culled: chunks %d/%d dots %d/%d fruits %d/%d ghosts %d/%d\n",
+	     gCullChunks.drawn, gCullChunks.culled, gCullDots.drawn, gCullDots.culled,
+	     gCullFruits.drawn, gCullFruits.culled, gCullGhosts.drawn, gCullGhosts.culled);
+      if (gAutopilot)
+	printAutopilotStats();
     }
+  return active;
+}
+
+/************ FRAME PACING ***************/
+
+/* GLUT timer - runs the frame that is due and sets the timer for the next */
+void frameTimer(int generation)
+{
+  int active;
+
+  // wakeFrames has set a newer timer, this one is stale
+  if (generation != gTimerGeneration)
+    return;
+
+  PacerWait();
+  active = UpdateFrame();
+  glutTimerFunc(PacerFrameDone(active, gSwapSeconds), frameTimer, generation);
+}
+
+/* something happened - show it, now if the pacer was idling */
+void wakeFrames(void)
+{
+  gRedraw = 1;
+  if (PacerLowPower()) {
+    PacerWake();
+    glutTimerFunc(0, frameTimer, ++gTimerGeneration);
+  }
+}
+
+/*
+  Set the swap interval if -vsync asked for it, and tell the pacer
+  whether swaps may wait for the vertical blank. Left to the driver,
+  they might - the pacer finds out from how long they take.
+*/
+void initialiseVsync(void)
+{
+  if (gVsyncOption < 0)
+    PacerSetVsync(1);
+  else if (setSwapInterval(gVsyncOption))
+    PacerSetVsync(gVsyncOption);
+  else {
+    printf("Could not set the swap interval, leaving vsync to the driver\n");
+    PacerSetVsync(1);
+  }
+}
+
+/* swaps wait for interval vertical blanks - 0 if there is no way to ask */
+int setSwapInterval(int interval)
+{
+  typedef void (*SwapIntervalEXT)(Display *, GLXDrawable, int);
+  typedef int (*SwapIntervalMESA)(unsigned int);
+  typedef int (*SwapIntervalSGI)(int);
+  Display *display = glXGetCurrentDisplay();
+  const char *extensions;
+
+  if (display == NULL)
+    return 0;
+  extensions = glXQueryExtensionsString(display, DefaultScreen(display));
+  if (extensions == NULL)
+    return 0;
+
+  if (strstr(extensions, "GLX_EXT_swap_control") != NULL) {
+    SwapIntervalEXT swapInterval = (SwapIntervalEXT) glXGetProcAddressARB((const GLubyte *) "glXSwapIntervalEXT");
+    swapInterval(display, glXGetCurrentDrawable(), interval);
+    return 1;
+  }
+  if (strstr(extensions, "GLX_MESA_swap_control") != NULL) {
+    SwapIntervalMESA swapInterval = (SwapIntervalMESA) glXGetProcAddressARB((const GLubyte *) "glXSwapIntervalMESA");
+    return swapInterval(interval) == 0;
+  }
+  // SGI can not turn vsync off
+  if ((strstr(extensions, "GLX_SGI_swap_control") != NULL) && (interval > 0)) {
+    SwapIntervalSGI swapInterval = (SwapIntervalSGI) glXGetProcAddressARB((const GLubyte *) "glXSwapIntervalSGI");
+    return swapInterval(interval) == 0;
+  }
+  return 0;
 }
 
 /************ PROJECTION MANIPULATIONS ***************/
@@ -651,18 +827,14 @@ void UpdateFrame(void)
 /* right click function to process the menu input to projection constant */
 void projectionMenu (int value) {
   projection = value;
-  glutPostRedisplay();
+  wakeFrames();
 }
 
 /* sets camera above pacman towards pacmans direction */
 void setFirstPersonProjection (void) {
-  /*
-  xPos = Man.cur->x + Man.xMov * gPacmanTimer;
-  zPos = Man.cur->z + Man.yMov * gPacmanTimer;
-  yPos =  (float) heightMap[xPos][zPos] + feet;
-  */
+  const Pacman *Man = &gState->Man;
   
-  if (Man.xMov > 0) {
+  if (Man->xMov > 0) {
     // look from -x to +x
     // check uphill or downhill
     /*if (heightMap[Man.cur->x][Man.cur->z] < heightMap[Man.cur->nbor.right->x][Man.cur->nbor.right->z])
@@ -674,19 +846,19 @@ void setFirstPersonProjection (void) {
 		    xPos, yPos, zPos, 
 		    0.0, 1.0, 0.0);
   }
-  else if (Man.xMov < 0) {
+  else if (Man->xMov < 0) {
     // look from +x to -x
     gluLookAt (xPos + camDist, yPos + camHeight, zPos, 
 		    xPos, yPos, zPos, 
 		    0.0, 1.0, 0.0);
   }
-  else if (Man.yMov < 0) {
+  else if (Man->yMov < 0) {
     // look from -z to +z
     gluLookAt (xPos, yPos + camHeight, zPos + camDist, 
 	       xPos, yPos, zPos, 
 	       0.0, 1.0, 0.0);
   }
-  else if (Man.yMov > 0) {
+  else if (Man->yMov > 0) {
     // look from +z to -z
     gluLookAt (xPos, yPos + camHeight, zPos - camDist, 
 	       xPos, yPos, zPos, 
@@ -701,139 +873,26 @@ void setFirstPersonProjection (void) {
   }
 }
 
-/* return to main menu when game is won or over */
-void returnToMenu(int win) {  
-  gameStart= 0;
-  projection = 1;
-  gameWin = win;
-}
-
-/************ FRACTAL GEOMETRY ***************/
-
-/* A function to fill the heightMap values using fractal geometry */
-void SetHeightMap(void)
-{
-  float c1, c2, c3, c4;
-  srand ( time(NULL) );
-		
-  /* Assign the height of four corners of the initial grid */	
-  c1 = (float) rand()/RAND_MAX;
-  c2 = (float) rand()/RAND_MAX;
-  c3 = (float) rand()/RAND_MAX;
-  c4 = (float) rand()/RAND_MAX;
-  DivideGrid(0, 0, gridSize, c1, c2, c3, c4);
-
-  SetThresholds();
-}
-
-/* A function to recursively randomize */
-void DivideGrid(int x, int y, float size, float c1, float c2, float c3, float c4)
-{
-  float e1, e2, e3, e4, mid, avg, max;
-  float newSize = size / 2;
-
-  // when each grid piece is bigger than a pixel
-  if (size > 1)
-    {		
-      //Randomly displace the midpoint!
-      avg = (c1 + c2 + c3 + c4) / 4;
-      max = newSize / (float)(gridSize) * 3;	
-      // special case for the first average to have occluded regions
-      if (size == gridSize)	
-	mid = 1.0f;
-      else
-	mid = avg + ((float) rand()/RAND_MAX - 0.5f) * max;
+/************ TICK INTERPOLATION ***************/
 
-      //Make sure that the midpoint doesn't accidentally "randomly displaced" past the boundaries!
-      if (mid < 0){
-	mid = 0;
-      }
-      else if (mid > 1.0f){
-	mid = 1.0f;
-      }
+/* pacman drawn between where it was one tick ago and where it is now */
+void interpolatePacman(float *x, float *z) {
+  float x0, z0, x1, z1;
 
-      //Calculate the edges by averaging the two corners of each edge.
-      e1 = (c1 + c2) / 2;
-      e2 = (c2 + c3) / 2;
-      e3 = (c3 + c4) / 2;
-      e4 = (c4 + c1) / 2;
-			
-      //Do the operation over again for each of the four new grids.			
-      DivideGrid(x, y, newSize, c1, e1, mid, e4);
-      DivideGrid(x + newSize, y, newSize, e1, c2, e2, mid);
-      DivideGrid(x + newSize, y + newSize, newSize, mid, e2, c3, e3);
-      DivideGrid(x, y + newSize, newSize, e4, mid, e3, c4);
-    }
-  else
-    {
-      //The four corners of the grid piece will be averaged
-      float c = (c1 + c2 + c3 + c4) / 4;
-      heightMap[x][y] = c*((gridSize/2) -1);
-    }
+  GamePacmanPosition(gPreviousState, &x0, &z0);
+  GamePacmanPosition(gState, &x1, &z1);
+  *x = x0 + (x1 - x0) * gTickAlpha;
+  *z = z0 + (z1 - z0) * gTickAlpha;
 }
 
-/* set the colors of terrain */
-GLfloat* SetColor (float color_val, int x, int z) 
-{
-  static float r1;
+/* a ghost drawn between where it was one tick ago and where it is now */
+void interpolateGhost(int ghost, float *x, float *z) {
+  float x0, z0, x1, z1;
 
-  // snow
-  if(color_val > snowThreshold ) {
-    colorVector[0] = 0.9f;
-    colorVector[1] = 0.9f;
-    colorVector[2] = 0.9f;
-  }
-  // mountain
-  else if(color_val > ((float) (gridSize/2) * 0.70f) && color_val > waterThreshold) {
-    r1 = (float) rand()/RAND_MAX;
-    r1 = 0.2f + (r1 * 0.2f);
-    colorVector[0] = r1;
-    colorVector[1] = r1 / 2.0f;
-    colorVector[2] = 0.0f;
-  }
-  // grass
-  else if(color_val > ((float) (gridSize/2) * 0.30f) && color_val > waterThreshold) {
-    r1 = (float) rand()/RAND_MAX;
-    r1 = 0.5f + (r1 * 0.2f);
-    colorVector[0] = 0.0f;
-    colorVector[1] = r1;
-    colorVector[2] = 0.0f;
-  }
-  // soil
-  else if(color_val > waterThreshold ){
-    r1 = (float) rand()/RAND_MAX;
-    r1 = 0.5f + (r1 * 0.2f);
-    colorVector[0] = r1;
-    colorVector[1] = r1;
-    colorVector[2] = r1 / 5.0f;
-  }
-  // water surface levels the heightMap low values
-  else {
-    heightMap[x][z] = waterThreshold;
-    colorVector[0] = 0.0f;
-    colorVector[1] = 0.0f;
-    colorVector[2] = 0.7f;
-  }
-  return colorVector;
-}
-
-/* Sets the height thresholds for snow and water areas */
-void SetThresholds (void) {
-  float values[(int)pow(ceil(gridSize / 10.0), 2)];
-  int counter = 0;
-  int i, j;
-  for(i = 0; i < gridSize; i = i + 10)
-    {
-      for(j = 0; j < gridSize; j = j + 10)
-	{
-	  values[counter] = heightMap[i][j];
-	  counter++;
-	}
-    }
-  std::nth_element(values, values + (int)floor(sizeof(values) * 0.10/4), values + (int)sizeof(values)/4);
-  waterThreshold = values[(int)floor(sizeof(values) * 0.10/4)];
-  std::nth_element(values, values + (int)floor(sizeof(values) * 0.90/4), values + (int)sizeof(values)/4);
-  snowThreshold = values[(int)floor(sizeof(values) * 0.90/4)]; 
+  GameGhostPosition(gPreviousState, ghost, &x0, &z0);
+  GameGhostPosition(gState, ghost, &x1, &z1);
+  *x = x0 + (x1 - x0) * gTickAlpha;
+  *z = z0 + (z1 - z0) * gTickAlpha;
 }
 
 /************ DRAWING CREATIONS ***************/
@@ -847,109 +906,93 @@ void renderBitmapString(float x, float y, void *font, char *string) {
   }
 }
 
-/* A function to draw the terrain using the heightMap values*/
-void DrawTerrain(void)
+/* the score and the menu, over the scene */
+void DrawMenuText(void)
 {
-  static int limit = gridSize -1;
+  // print score
+  sprintf(scoreBuf, "Score: %d", gState->score);
+  glColor3f(1.0f, 1.0f, 1.0f);
+  renderBitmapString(10, 40, GLUT_BITMAP_HELVETICA_18,scoreBuf);
+
+  // main menu if game hasnt started
+  if (gState->gameStart < 1) {
+    glColor3f(1., 0., 0.);
+    if (gState->gameWin > 0) {
+      // if game is won, print YOU WON
+      renderBitmapString(10, 20, GLUT_BITMAP_HELVETICA_18, winBuf);
+      glColor3f(1., 0., 0.);
+      renderBitmapString(10, 60, GLUT_BITMAP_HELVETICA_12, quitBuf);
+    }
+    else if (gState->gameWin < 0) {
+      // if game is lost, print GAME OVER
+      renderBitmapString(10, 20, GLUT_BITMAP_HELVETICA_18, loseBuf);
+      glColor3f(1., 0., 0.);
+      renderBitmapString(10, 60, GLUT_BITMAP_HELVETICA_12, quitBuf);
+    }
+    else {
+      // if game hasnt started, welcome
+      renderBitmapString(10, 20, GLUT_BITMAP_HELVETICA_18,titleBuf);
+      glColor3f(1., 0., 0.);
+      renderBitmapString(10, 60, GLUT_BITMAP_HELVETICA_12, enterBuf);
+    }
+  } else {
+    // write PACMAN 3D if you are already in game
+    glColor3f(0.0f, 0.0f, 0.7f);
+    renderBitmapString(10,20,GLUT_BITMAP_HELVETICA_18,titleBuf); 
+    glColor3f(1., 0., 0.);
+    renderBitmapString(10, 60, GLUT_BITMAP_HELVETICA_12, cameraBuf);
+  }
+}
 
-  /* I can fill the terrain with triangles. */
+/* the mean and worst time of every phase over the last frames, with a
+   bar for the mean on a scale where a 60Hz frame fills the bar */
+void DrawProfileOverlay(void)
+{
+  const float left = gWindowWidth - 340.f, barLeft = left + 150.f;
+  const float barWidth = 120.f, frameBudget = 1.f / 60.f;
+  char line[64];
+  float mean, max, gpuMean, gpuMax;
 
-  /* Triangles (x,z) (x+1,z) (x, z+1) Left */
-  glBegin(GL_TRIANGLES);
-  for(int x=0; x<limit; x++)
-    for(int z=0; z<limit; z++)
-      {
-	glColor3fv(SetColor(heightMap[x][z], x, z));
-	
-	/* Calculating the normal vector
-	   The 4 vectors surrounding the vertex is 
-	   v1 (1, heightMap[x+1][z] - heightMap[x][z], 0)
-	   v2 (0, heightMap[x][z+1] - heightMap[x][z], 1)
-	   v3 (-1, heightMap[x-1][z] - heightMap[x][z], 0)
-	   v4 (0, heightMap[x][z-1] - heightMap[x][z], -1)
-	   v12 (heightMap[x+1][z] - heightMap[x][z], -1, 
-	        heightMap[x][z+1] - heightMap[x][z])
-	   v23 (- heightMap[x-1][z] - heightMap[x][z], 
-	        -1, heightMap[x][z+1] - heightMap[x][z])
-	   v34 (- heightMap[x-1][z] - heightMap[x][z], -1, 
-	        - heightMap[x][z-1] - heightMap[x][z])
-	   v41 (- heightMap[x+1][z] - heightMap[x][z], -1, 
-	        - heightMap[x][z-1] - heightMap[x][z])
-	   sum (-2 * heightMap[x-1][z] - heightMap[x][z], 
-	        -4, 2 * heightMap[x][z+1] - heightMap[x][z-1])
-	*/
-	glNormal3f(-2 * (heightMap[x-1][z] - heightMap[x][z]), -4, 
-		   2 * (heightMap[x][z+1] - heightMap[x][z-1]));
-	glVertex3f(x, heightMap[x][z], z);
-	glNormal3f(-2 * (heightMap[x][z] - heightMap[x+1][z]), -4, 
-		   2 * (heightMap[x+1][z+1] - heightMap[x+1][z-1]));
-	glVertex3f(x+1, heightMap[x+1][z], z);
-	glNormal3f(-2 * (heightMap[x-1][z+1] - heightMap[x][z+1]), -4, 
-		   2 * (heightMap[x][z+2] - heightMap[x][z]));
-	glVertex3f(x, heightMap[x][z+1], z+1);
-      }
-  glEnd();
-
-  /* Triangles (x,z) (x-1,z) (x, z-1) Right */
-  glBegin(GL_TRIANGLES);
-  for(int x=limit; x>0; x--)
-    for(int z=limit; z>0; z--)
-      {
-	glColor3fv(SetColor(heightMap[x][z], x, z));
-
-	/* Calculating the normal vector as above */
-	glNormal3f(-2 * (heightMap[x-1][z] - heightMap[x][z]), -4, 
-		   2 * (heightMap[x][z+1] - heightMap[x][z-1]));
-	glVertex3f(x, heightMap[x][z], z);
-	glNormal3f(-2 * (heightMap[x-2][z] - heightMap[x-1][z]), -4, 
-		   2 * (heightMap[x-1][z+1] - heightMap[x-1][z-1]));
-	glVertex3f(x-1, heightMap[x-1][z], z);
-	glNormal3f(-2 * (heightMap[x-1][z-1] - heightMap[x][z-1]), -4, 
-		   2 * (heightMap[x][z] - heightMap[x][z-2]));
-	glVertex3f(x, heightMap[x][z-1], z-1);
-      }
-  glEnd();
-
-  /* Then, I want to draw the sides. */
-  /* Color */
-  glColor3f (0.3, 0.3, 0.1);
-
-  /* Side 1 x, 0 */
-  glBegin(GL_POLYGON);
-  glVertex3f(limit, 0, 0);
-  for(int x=limit; x > -1; x--)
-    glVertex3f(x, heightMap[x][0], 0);
-  glVertex3f(0, 0, 0);
-  glEnd(); 
-  /* Side 2 0, z */
-  glBegin(GL_POLYGON);
-  glVertex3f(0, 0, 0);
-  for(int z=0; z<gridSize; z++)
-    glVertex3f(0, heightMap[0][z], z);
-  glVertex3f(0, 0, limit);
-  glEnd(); 
-  /* Side 3 x, limit */
-  glBegin(GL_POLYGON);
-  glVertex3f(0, 0, limit);
-  for(int x=0; x<gridSize; x++)
-    glVertex3f(x, heightMap[x][limit], limit);
-  glVertex3f(limit, 0, limit);
-  glEnd();
-  /* Side 4 limit, z */
-  glBegin(GL_POLYGON);
-  glVertex3f(limit, 0, 0);
-  for(int z=0; z<gridSize; z++)
-    glVertex3f(limit, heightMap[limit][z], z);
-  glVertex3f(limit, 0, limit);
-  glEnd();
+  glDisable(GL_LIGHTING);
+  glDisable(GL_DEPTH_TEST);
+
+  ProfileFrameStats(&mean, &max);
+  glColor3f(0.0f, 0.0f, 0.7f);
+  sprintf(line, "frame  %.2f / %.2f ms", mean * 1e3f, max * 1e3f);
+  renderBitmapString(left, 20, GLUT_BITMAP_HELVETICA_12, line);
+
+  for (int p = 0; p < PROFILE_PHASES; p++) {
+    const float y = 38.f + 16.f * p;
+
+    ProfilePhaseStats(p, &mean, &max);
+    glColor3f(0.0f, 0.0f, 0.7f);
+    sprintf(line, "%s  %.2f / %.2f", profilePhaseNames[p], mean * 1e3f, max * 1e3f);
+    renderBitmapString(left, y, GLUT_BITMAP_HELVETICA_12, line);
 
+    // GPU time goes further right, when timer queries have reported any
+    if (ProfileGpuStats(p, &gpuMean, &gpuMax) > 0) {
+      sprintf(line, "gpu %.2f", gpuMean * 1e3f);
+      renderBitmapString(barLeft + barWidth + 8.f, y, GLUT_BITMAP_HELVETICA_12, line);
+    }
+
+    glColor3f(1., 0.5, 0.);
+    glBegin(GL_QUADS);
+    glVertex2f(barLeft, y - 10.f);
+    glVertex2f(barLeft + barWidth * std::min(mean / frameBudget, 1.f), y - 10.f);
+    glVertex2f(barLeft + barWidth * std::min(mean / frameBudget, 1.f), y);
+    glVertex2f(barLeft, y);
+    glEnd();
+  }
+
+  glEnable(GL_DEPTH_TEST);
+  glEnable(GL_LIGHTING);
 }
 
 /* drawing pacman with solid sphere */
 void DrawPacman(void)
 {
   glColor3f(1.0f, 1.0f, 0.0f);
-  glutSolidSphere(5.0, 10, 10);
+  gluSphere(theSphere, 5.0, 10, 10);
 }
 
 /* drawing fruit with NURBS spline */
@@ -1008,9 +1051,9 @@ void DrawGhost(void)
   glPushMatrix();
   glColor3f(1.0f, 1.0f, 1.0f);
   glTranslatef(1.5, 1.5, 0.);
-  glutSolidSphere(0.5, 5, 5);
+  gluSphere(theSphere, 0.5, 5, 5);
   glTranslatef(-3., 0., 0.);
-  glutSolidSphere(0.5, 5, 5);
+  gluSphere(theSphere, 0.5, 5, 5);
   glPopMatrix();
 
   /* for testing the points of bezier curve
@@ -1033,469 +1076,530 @@ void DrawGhost(void)
 void DrawDot(int quality)
 {
   glColor3f(1.0f, 1.0f, 1.0f);
-  glutSolidSphere(1.0, quality, quality);
+  gluSphere(theSphere, 1.0, quality, quality);
 }
 
-/************ ADJACENCY LIST CREATION ***************/
-
-/* creates the adjacency list */
-void createAdjacencyList(void) {
-  numDots = 0;
-  static int gap = (gridSize - (DistPaths * NodesPerLine)) / 2;
-  static int height;
-
-  // create all the nodes with pos values and neighbors
-  for(int i = 0; i < NodesPerLine; i++) {
-    for(int j = 0; j < NodesPerLine; j++) {
-      Nodes[i][j].x = gap + (i + (1/2.f)) * DistPaths;
-      Nodes[i][j].z = gap + (j + (1/2.f)) * DistPaths;
-
-      height = heightMap[Nodes[i][j].x][Nodes[i][j].z];
-      if((height >= snowThreshold) || (height <= waterThreshold)) {
-	Nodes[i][j].ingame = 0;
-      } else
-	Nodes[i][j].ingame = 1;
-
-      Nodes[i][j].traversed = 0;
-      Nodes[i][j].dot = 0;
-      Nodes[i][j].ppill = 0;
-      Nodes[i][j].numadj = 0;
-    }
-  }
-
-  // Pacman's starting node
-  startX = NodesPerLine / 2;
-  startZ = NodesPerLine / 4;
-
-  Man.cur = findPacmanStartNode(startX, startZ); 
-  // find the nodes connected to the startNode
-  traverseNeighbors(Man.cur, startX, startZ);
+/************ HEADLESS RUNS ***************/
 
-  // place powerpills on the corners 
-  for (int i = 0; i < NodesPerLine; i += NodesPerLine - 1)
-    for (int j = 0; j < NodesPerLine; j += NodesPerLine - 1)
-      placePowerpill(i, j);
+/*
+  Play one game without a window, pacman wandering in a random
+  direction every second of game time. Reports the outcome and how
+  many simulation steps we managed per second.
+*/
+int RunHeadless(long ticks)
+{
+  GameInput input;
+  Random moves;
+  clock_t begin;
+  double seconds;
+  long tick;
+
+  gState = GameCreate(&gWorld, gNumGhosts);
+  gState->chase = gChase;
+  RandomSeed(&moves, gWorld.seed, RANDOM_INPUT);
+  if ((gRecordFile != NULL) && !ReplayRecordStart(gRecordFile, gState))
+    printf("Could not record to %s\n", gRecordFile);
+
+  begin = clock();
+  for (tick = 0; (tick < ticks) && ((tick == 0) || (gState->gameStart > 0)); tick++) {
+    if (gAutopilot)
+      AutopilotPolicy(gState, &moves, &input);
+    else
+      BatchWander(gState, &moves, &input);
+    input.start = (tick == 0);
+    ReplayRecordInput(gState->tick, &input);
+    GameStep(gState, &input);
+  }
+  seconds = (double) (clock() - begin) / CLOCKS_PER_SEC;
+
+  printf("Ticks: %ld Score: %d Dots left: %d Result: %d\n",
+	 tick, gState->score, gState->numDots, gState->gameWin);
+  if (seconds > 0.)
+    printf("Ticks per second: %.0f\n", tick / seconds);
+  if (gAutopilot)
+    printAutopilotStats();
+  ReplayRecordFinish(gState);
+  GameFree(gState);
+  return 0;
 }
 
-/* traverse through to all connected points */
-void traverseNeighbors(Node *node, int x, int y) {
-  // if node is already checked, there is no need to check again
-  if (node->traversed > 0)
-    return;
+/*
+  Play a recording back as fast as we can and check the game ends the
+  way it did when it was recorded. Exits with 1 if it does not.
+*/
+int RunReplay(void)
+{
+  GameInput input;
+  clock_t begin;
+  double seconds;
+  int matches;
+
+  gState = GameCreate(&gWorld, gNumGhosts);
+  gState->chase = gChase;
+
+  begin = clock();
+  while (gState->tick < gReplay.ending.tick) {
+    ReplayNextInput(&gReplay, gState->tick, &input);
+    GameStep(gState, &input);
+  }
+  seconds = (double) (clock() - begin) / CLOCKS_PER_SEC;
+
+  printf("Ticks: %d Score: %d Dots left: %d Result: %d\n",
+	 gState->tick, gState->score, gState->numDots, gState->gameWin);
+  matches = ReplayMatches(&gReplay, gState);
+  if (matches)
+    printf("Replay matches the recording\n");
+  if (seconds > 0.)
+    printf("Ticks per second: %.0f\n", gState->tick / seconds);
+  GameFree(gState);
+  ReplayFree(&gReplay);
+  return matches ? 0 : 1;
+}
 
-  node->traversed = 1;
+/*
+  Play numGames games on consecutive seeds from -seed across the thread
+  pool, each on its own world, and write one line of results per game.
+*/
+int RunBatch(int numGames)
+{
+  BatchGame *games = (BatchGame *) calloc(numGames, sizeof(BatchGame));
+  FILE *file = stdout;
+  int jsonLines = 0;
+  long ticks = 0;
+  int skipped = 0;
+  double begin, seconds;
+
+  if (gOutFile != NULL) {
+    const size_t length = strlen(gOutFile);
+    jsonLines = (length > 6) && (strcmp(gOutFile + length - 6, ".jsonl") == 0);
+    file = fopen(gOutFile, "w");
+    if (file == NULL) {
+      printf("Could not write to %s\n", gOutFile);
+      free(games);
+      return 1;
+    }
+  }
 
-  // if it is on traversal and ingame, there is a dot and neighbors
-  // if it is out of the game, do not traverse any further
-  if (node->ingame > 0) {
-    node->dot = 1;
-    numDots++;
-    node->numadj = 0;
+  for (int i = 0; i < numGames; i++) {
+    games[i].seed = gSeed + i;
+    games[i].gridSize = gGridSize;
+    games[i].numGhosts = gNumGhosts;
+    games[i].chase = gChase;
+    games[i].maxTicks = (gHeadlessTicks > 0) ? gHeadlessTicks : batchMaxTicks;
   }
-  else return;
-  
-  // if we are not on the edge, check the left neigbor and recurse
-  if (x > 0)
-    if (Nodes[x-1][y].ingame > 0) {
-      (node->nbor).left = &Nodes[x-1][y];
-      node->adj[node->numadj] = &Nodes[x-1][y];
-      node->numadj++;
-      traverseNeighbors(&Nodes[x-1][y], x-1, y);
-    }
-    else (node->nbor).left = NULL;
-  else (node->nbor).left = NULL;
-  
-  // if we are not on the edge, check the right neigbor and recurse
-  if (x < NodesPerLine - 1)
-    if (Nodes[x+1][y].ingame > 0) {
-      (node->nbor).right = &Nodes[x+1][y];
-      node->adj[node->numadj] = &Nodes[x+1][y];
-      node->numadj++;
-      traverseNeighbors(&Nodes[x+1][y], x+1, y);
-    }
-    else (node->nbor).right = NULL;
-  else (node->nbor).right = NULL;
-  
-  // if we are not on the edge, check the up neigbor and recurse
-  if (y < NodesPerLine - 1)
-    if (Nodes[x][y+1].ingame > 0) {
-      (node->nbor).up = &Nodes[x][y+1];
-      node->adj[node->numadj] = &Nodes[x][y+1];
-      node->numadj++;
-      traverseNeighbors(&Nodes[x][y+1], x, y+1);
-    }
-    else (node->nbor).up = NULL;
-  else (node->nbor).up = NULL;
-  
-  // if we are not on the edge, check the down neigbor and recurse
-  if (y > 0)
-    if (Nodes[x][y-1].ingame > 0) {
-      (node->nbor).down = &Nodes[x][y-1];
-      node->adj[node->numadj] = &Nodes[x][y-1];
-      node->numadj++;
-      traverseNeighbors(&Nodes[x][y-1], x, y-1);
-    }
-    else (node->nbor).down = NULL;
-  else (node->nbor).down = NULL;
-}
 
-/* find a suitable start node for pacman */
-Node* findPacmanStartNode (int starterX, int starterZ) {
+  begin = GetTimeInSeconds();
+  BatchRun(games, numGames, gAutopilot ? AutopilotPolicy : BatchWander);
+  seconds = GetTimeInSeconds() - begin;
 
-  // while it is in game and has at least 1 neighbor
+  BatchWrite(file, games, numGames, jsonLines);
+  if (file != stdout)
+    fclose(file);
 
-  while((Nodes[starterX][starterZ].ingame < 1) &&
-	((Nodes[starterX+1][starterZ].ingame < 1) || 
-	 (Nodes[starterX-1][starterZ].ingame < 1) || 
-	 (Nodes[starterX][starterZ+1].ingame < 1) || 
-	 (Nodes[starterX][starterZ-1].ingame < 1)) ) {
-    // if startNode is out of game, check other possibilities on z line
-    starterZ++;
+  // the summary goes to stderr, out of the way of results on stdout
+  for (int i = 0; i < numGames; i++) {
+    ticks += games[i].ticks;
+    skipped += !games[i].valid;
   }
-  return &Nodes[starterX][starterZ];
+  if (skipped > 0)
+    fprintf(stderr, "%d of %d worlds had no maze to play on and were skipped\n", skipped, numGames);
+  fprintf(stderr, "%d games, %ld ticks in %.2f seconds on %d threads - %.1f games, %.0f ticks per second\n",
+	  numGames, ticks, seconds, ThreadPoolSize(), numGames / seconds, ticks / seconds);
+  if (gAutopilot)
+    printAutopilotStats();
+  free(games);
+  return 0;
 }
 
-/* place poerpills on the corners */
-void placePowerpill(int x, int y) {
-  // check the corners
-  // if there is a dot, replace it with a powerpill
-  if (Nodes[x][y].dot > 0) {
-    Nodes[x][y].dot = 0;
-    Nodes[x][y].ppill = 1;
+/************ RENDER BENCHMARK ***************/
+
+/*
+  Draw frames into an offscreen framebuffer, with the camera following
+  pacman as it wanders the maze for frames ticks in each of the three
+  projections in turn. Every frame records the CPU time GameDrawScene
+  takes to submit, the GPU time of its passes and the time until
+  glFinish returns, and each projection gets a line of statistics for
+  every one of them.
+*/
+int RunRenderBench(int frames)
+{
+  const int width = (int) gWindowWidth, height = (int) gWindowHeight;
+  double *cpu, *gpu, *total;
+  unsigned char *pixels;
+  FILE *file = stdout;
+  GameInput input;
+  Random moves;
+  int timerQueries;
+  double begin;
+
+  if (!OffscreenCreate(width, height)) {
+    fprintf(stderr, "Could not draw offscreen, no render benchmark\n");
+    return 1;
   }
-}
+  gOffscreen = 1;
+  if ((gOutFile != NULL) && ((file = fopen(gOutFile, "w")) == NULL)) {
+    fprintf(stderr, "Could not write to %s\n", gOutFile);
+    OffscreenFree();
+    return 1;
+  }
+  fprintf(stderr, "Drawing %dx%d offscreen with %s, OpenGL %s\n", width, height,
+	  glGetString(GL_RENDERER), glGetString(GL_VERSION));
 
-/************ GHOST MANIPULATIONS ***************/
-
-/* create ghosts by filling values */
-void createGhosts(void) {
-  startZ += NodesPerLine / 2;
-
-  // create red ghost going down
-  Ghosts[0].alive = 1;
-  Ghosts[0].r = 1.;
-  Ghosts[0].g = 0.;
-  Ghosts[0].b = 0.; 
-  Ghosts[0].xMov = 0; 
-  Ghosts[0].yMov = -1; 
-  Ghosts[0].ghostTimer = ghostRandomTime; 
-  Ghosts[0].cur = findStartNode(startX, startZ);
-  checkStartDirection(&Ghosts[0]);
-
-  // create cyan ghost going up
-  startZ++;
-  Ghosts[1].alive = 1;
-  Ghosts[1].r = 0.;
-  Ghosts[1].g = 1.;
-  Ghosts[1].b = 1.; 
-  Ghosts[1].xMov = 0; 
-  Ghosts[1].yMov = 1; 
-  Ghosts[1].ghostTimer = ghostRandomTime; 
-  Ghosts[1].cur = findStartNode(startX, startZ);
-  checkStartDirection(&Ghosts[1]);
-
-  // create orange ghost going right
-  startX++;
-  Ghosts[2].alive = 1;
-  Ghosts[2].r = 1.;
-  Ghosts[2].g = 0.5;
-  Ghosts[2].b = 0.; 
-  Ghosts[2].xMov = 1; 
-  Ghosts[2].yMov = 0; 
-  Ghosts[2].ghostTimer = ghostRandomTime; 
-  Ghosts[2].cur = findStartNode(startX, startZ);
-  checkStartDirection(&Ghosts[2]);
-
-  // create pink ghost going left
-  startX -= 2;
-  Ghosts[3].alive = 1;
-  Ghosts[3].r = 1.;
-  Ghosts[3].g = 0.5;
-  Ghosts[3].b = 0.5; 
-  Ghosts[3].xMov = -1; 
-  Ghosts[3].yMov = 0; 
-  Ghosts[3].ghostTimer = ghostRandomTime; 
-  Ghosts[3].cur = findStartNode(startX, startZ);
-  checkStartDirection(&Ghosts[3]);
-}
+  cpu = (double *) malloc(frames * sizeof(double));
+  gpu = (double *) malloc(frames * sizeof(double));
+  total = (double *) malloc(frames * sizeof(double));
+  pixels = (unsigned char *) malloc((size_t) width * height * 4);
 
-/* if a ghost hits a border, randomize its movement */
-void randomize(Ghost* ghost) {
-  static int rn, x, z, xdiff, zdiff;
+  gState = GameCreate(&gWorld, gNumGhosts);
+  gState->chase = gChase;
+  gPreviousState = GameClone(gState);
 
-  // stop the movement
-  ghost->xMov = 0;
-  ghost->yMov = 0;
+  InitialiseOpenGL();
+  begin = GetTimeInSeconds();
+  InitialiseScene();
+  glFinish();
+  fprintf(stderr, "Scene built in %.1f ms\n", (GetTimeInSeconds() - begin) * 1e3);
+  GameResize(width, height);
+
+  timerQueries = GpuTimerCreate();
+  if (!timerQueries)
+    fprintf(stderr, "No timer queries, GPU time is the wait in glFinish\n");
+
+  for (projection = 0; projection < totalProjections; projection++) {
+    // every camera watches the same game from its start
+    RandomSeed(&moves, gWorld.seed, RANDOM_INPUT);
+    GameReset(gState);
+    DotsCreate(gState, feet/4, gHQDot);
+
+    for (int f = -renderWarmupFrames; f < frames; f++) {
+      // pacman caught, so play again rather than time a still scene
+      if ((gState->tick > 0) && (gState->gameStart < 1)) {
+	GameReset(gState);
+	DotsCreate(gState, feet/4, gHQDot);
+      }
 
-  x = ghost->cur->x;
-  z = ghost->cur->z;
+      // one tick a frame, drawn halfway to the next as a window mostly is
+      ProfileNextFrame();
+      GpuTimerNextFrame();
+      BatchWander(gState, &moves, &input);
+      input.start = (gState->tick == 0);
+      ProfileBegin(PROFILE_TICK);
+      GameCopy(gPreviousState, gState);
+      if (GameStep(gState, &input) & GAME_EVENT_DOT)
+	DotsClear(gState->Man.cur);
+      ProfileEnd(PROFILE_TICK);
+      gTickAlpha = 0.5f;
+
+      const double start = GetTimeInSeconds();
+      GameDrawScene();
+      const double submitted = GetTimeInSeconds();
+      glFinish();
+      const double finished = GetTimeInSeconds();
+      // all drawn, so reading the queries costs no stall
+      GpuTimerFlush();
+
+      if (f < 0)
+	continue;
+      cpu[f] = (submitted - start) * 1e3;
+      total[f] = (finished - start) * 1e3;
+      if (timerQueries)
+	gpu[f] = ProfileFrameGpu(ProfileFrameNumber()) * 1e3;
+      else
+	gpu[f] = (finished - submitted) * 1e3;
+    }
 
-  // pick a random node form its adjacent neighbors list
-  rn = rand() % ghost->cur->numadj;
+    writeRenderStats(file, "cpu", cpu, frames);
+    writeRenderStats(file, "gpu", gpu, frames);
+    writeRenderStats(file, "frame", total, frames);
 
-  // define the new direction towards the picked node
-  xdiff = ghost->cur->adj[rn]->x - x;
-  zdiff = ghost->cur->adj[rn]->z - z;
+    // the same seed draws the same last frame, unless the drawing changed
+    OffscreenRead(pixels);
+    fprintf(stderr, "  last frame checksum %016llx\n", imageChecksum(pixels, (size_t) width * height * 4));
+  }
 
-  if(xdiff > 0)
-    ghost->xMov = 1;  
-  else if (xdiff < 0)
-    ghost->xMov = -1;
-  else if (zdiff > 0)
-    ghost->yMov = 1; 
-  else if (zdiff < 0)
-    ghost->yMov = -1;      
+  if (file != stdout)
+    fclose(file);
+  if (gProfileFile != NULL)
+    writeProfile();
+  GpuTimerFree();
+  free(cpu);
+  free(gpu);
+  free(total);
+  free(pixels);
+  GameFree(gPreviousState);
+  GameFree(gState);
+  OffscreenFree();
+  return 0;
 }
 
-/* find a suitable starting node for a ghost */
-Node* findStartNode (int starterX, int starterZ) {
-  while((Nodes[starterX][starterZ].ingame < 1) && 
-	(Nodes[starterX][starterZ].numadj < 1)) {
-    // if startNode is out of game, check other possibilities on z line
-    starterZ++;
-  }
-  return &Nodes[starterX][starterZ];
+/* one line of JSON for a measure of the current projection, in the form pacbench writes */
+void writeRenderStats(FILE *file, const char *measure, double *samples, int count)
+{
+  double sum = 0.;
+  double p[3];
+  const double ranks[3] = { 0.50, 0.90, 0.99 };
+
+  std::sort(samples, samples + count);
+  for (int i = 0; i < count; i++)
+    sum += samples[i];
+  for (int r = 0; r < 3; r++)
+    p[r] = samples[std::max(0, std::min((int) ceil(ranks[r] * count), count) - 1)];
+
+  fprintf(file, "{\"stage\":\"render_%s_%s\",\"size\":%d,\"unit\":\"ms\",\"samples\":%d,"
+	  "\"mean\":%.4f,\"min\":%.4f,\"p50\":%.4f,\"p90\":%.4f,\"p99\":%.4f,\"max\":%.4f}\n",
+	  projectionNames[projection], measure, gWorld.gridSize, count,
+	  sum / count, samples[0], p[0], p[1], p[2], samples[count - 1]);
+  fprintf(stderr, "%-12s %-5s mean %8.3f  p50 %8.3f  p90 %8.3f  p99 %8.3f  max %8.3f ms\n",
+	  projectionNames[projection], measure, sum / count, p[0], p[1], p[2], samples[count - 1]);
 }
 
-/* check the direction of the ghost in the start to see if its suitable*/
-void checkStartDirection(Ghost* ghost) {
+/* FNV-1a over the pixels of a frame */
+unsigned long long imageChecksum(const unsigned char *pixels, size_t size)
+{
+  unsigned long long hash = 0xcbf29ce484222325ULL;
 
-  // randomize if its not possible to move int hat direction
-  if (ghost->xMov > 0) {
-    if (ghost->cur->nbor.right == NULL)
-      randomize(ghost);
-  }
-  else if (ghost->xMov < 0) {
-    if (ghost->cur->nbor.left == NULL)
-      randomize(ghost); 
-  }
-  else if (ghost->yMov > 0) {
-    if (ghost->cur->nbor.up == NULL)
-      randomize(ghost); 
-  }
-  else if (ghost->yMov < 0) {
-    if (ghost->cur->nbor.down == NULL)
-      randomize(ghost); 
-  }
+  for (size_t i = 0; i < size; i++)
+    hash = (hash ^ pixels[i]) * 0x100000001b3ULL;
+  return hash;
 }
 
-/* update ghosts positioning */
-void updateGhosts(void) {
-  for(int i = 0; i < 4; i++) {    
-    if (Ghosts[i].xMov > 0) {
-	Ghosts[i].cur = Ghosts[i].cur->nbor.right;
-	checkGhostTimer(&Ghosts[i]);
-      if (Ghosts[i].cur->nbor.right == NULL)
-	randomize(&Ghosts[i]);
-    }
-    else if (Ghosts[i].xMov < 0) {
-	Ghosts[i].cur = Ghosts[i].cur->nbor.left; 
-	checkGhostTimer(&Ghosts[i]);
-      if (Ghosts[i].cur->nbor.left == NULL)
-	randomize(&Ghosts[i]);
-    }
-    else if (Ghosts[i].yMov > 0) {
-	Ghosts[i].cur = Ghosts[i].cur->nbor.up; 
-	checkGhostTimer(&Ghosts[i]);
-      if (Ghosts[i].cur->nbor.up == NULL)
-	randomize(&Ghosts[i]);
-    }
-    else if (Ghosts[i].yMov < 0) {
-	Ghosts[i].cur = Ghosts[i].cur->nbor.down;  
-	checkGhostTimer(&Ghosts[i]);
-      if (Ghosts[i].cur->nbor.down == NULL)
-	randomize(&Ghosts[i]); 
-    }
-  }
-}
+/************ AUTOPILOT ***************/
 
-/* check if it time for the ghost to randomize */
-void checkGhostTimer(Ghost* ghost) {
-  ghost->ghostTimer--;
-  if (ghost->ghostTimer == 0) {
-    randomize(ghost);
-    ghost->ghostTimer = ghostRandomTime;
-  }
-}
+/* how hard the autopilot has been searching */
+void printAutopilotStats(void)
+{
+  long rollouts;
+  double seconds;
 
+  AutopilotStats(&rollouts, &seconds);
+  if (seconds > 0.)
+    fprintf(stderr, "Autopilot: %ld rollouts in %.2f seconds of search, %.0f rollouts per second\n",
+	    rollouts, seconds, rollouts / seconds);
+}
 
-/************ PACMAN MANIPULATIONS ***************/
+/************ RECORDING ***************/
 
-/* create pacman by filling its fields */
-void createPacman(void) {
-  Man.alive = 1; 
-  Man.xMov = 0; 
-  Man.yMov = 0; 
-  // Man.cur defined earlier when creating adjacency matrix
+/* the window only closes through exit(), so the recording ends there */
+void finishRecording(void)
+{
+  ReplayRecordFinish(gState);
 }
 
-/* refresh pacmans position */
-void refreshPacman(void) {
-  checkCollision();
-
-  updatePacmanPosition();
-  updatePacmanMovement();
-  checkPacmanMovement();
+/************ PROFILING ***************/
 
-  addScores();
-  checkCollision();
+/* a drawing pass, timed on the CPU and, where it can be, on the GPU */
+void beginPass(int phase)
+{
+  ProfileBegin(phase);
+  GpuTimerBegin(phase);
 }
 
-/* update pacmans position */
-void updatePacmanPosition(void) {
-  // change the node according to the direction
-  if (Man.xMov > 0) {
-    Man.cur = Man.cur->nbor.right;
-  }
-  else if (Man.xMov < 0) {
-    Man.cur = Man.cur->nbor.left;
-  }
-  else if (Man.yMov < 0) {
-    Man.cur = Man.cur->nbor.down;
-  }
-  else if (Man.yMov > 0) {
-    Man.cur = Man.cur->nbor.up;
-  }
+void endPass(int phase)
+{
+  GpuTimerEnd(phase);
+  ProfileEnd(phase);
 }
 
-/* update pacmans direction */
-void updatePacmanMovement(void) { 
-  // get the read from keyboard and update pacmans movement in the next node
-  if ((pacmanNewX != 0) || (pacmanNewY != 0)) {
-    Man.xMov = pacmanNewX;
-    Man.yMov = pacmanNewY;
-    pacmanNewX = 0;
-    pacmanNewY = 0;
-  }
-}
+/* the frames in the profile ring, to gProfileFile */
+void writeProfile(void)
+{
+  const size_t length = strlen(gProfileFile);
+  FILE *file = fopen(gProfileFile, "w");
 
-/* check pacmans direction to see if its suitable*/
-void checkPacmanMovement(void) {
-  // if it is trying to go to a border, stop
-
-  if (Man.xMov > 0) {
-    if (Man.cur->nbor.right == NULL)
-      stopPacman();
-    // if Pacman is going uphill slow down ghosts
-    else if (heightMap[Man.cur->x][Man.cur->z] < 
-	     heightMap[Man.cur->nbor.right->x][Man.cur->nbor.right->z])
-      ghostRate=slowGhostRate;
-    else
-      ghostRate=initialGhostRate;
-  }
-  else if (Man.xMov < 0) {
-    if (Man.cur->nbor.left == NULL)
-      stopPacman();
-    // if Pacman is going uphill slow down ghosts
-    else if (heightMap[Man.cur->x][Man.cur->z] < 
-	     heightMap[Man.cur->nbor.left->x][Man.cur->nbor.left->z])
-      ghostRate=slowGhostRate;
-    else
-      ghostRate=initialGhostRate;
-  }
-  else if (Man.yMov < 0) {
-    if (Man.cur->nbor.down == NULL)
-      stopPacman();
-    // if Pacman is going uphill slow down ghosts
-    else if (heightMap[Man.cur->x][Man.cur->z] < heightMap[Man.cur->nbor.down->x][Man.cur->nbor.down->z])
-      ghostRate=slowGhostRate;
-    else
-      ghostRate=initialGhostRate;
-  }
-  else if (Man.yMov > 0) {
-    if (Man.cur->nbor.up == NULL)
-      stopPacman();
-    // if Pacman is going uphill slow down ghosts
-    else if (heightMap[Man.cur->x][Man.cur->z] < heightMap[Man.cur->nbor.up->x][Man.cur->nbor.up->z])
-      ghostRate=slowGhostRate;
-    else
-      ghostRate=initialGhostRate;
+  if (file == NULL) {
+    fprintf(stderr, "Could not write the profile to %s\n", gProfileFile);
+    return;
   }
+  if ((length > 4) && (strcmp(gProfileFile + length - 4, ".csv") == 0))
+    ProfileWriteCSV(file);
+  else
+    ProfileWriteTrace(file);
+  fclose(file);
 }
 
-/* stop pacmans movement */
-void stopPacman(void) {
-  Man.xMov = 0;
-  Man.yMov = 0;
-}
-
-/************ SCORING ROUTINES ***************/
+/************ MAZE ANALYSIS ***************/
 
-/* adding scores if pacman hits a dot or ppill */
-void addScores(void) {
-  if (Man.cur->dot > 0) {
-    // add score
-    score = score + dotScore;
-    Man.cur->dot = 0;
-    // decrease the number of dots
-    numDots--;
-  }
-
-  if (Man.cur->ppill > 0) {
-    // add score
-    score = score + ppillScore;
-    Man.cur->ppill = 0;
-    numDots--;
+/*
+  Read the distance table saved for this map, or search the maze and
+  save it there for next time, then grade the level by how far its
+  dots lie from pacman's start.
+*/
+void PrepareDistances(const char *path)
+{
+  const int start = gWorld.pacmanStart;
+  double begin = GetTimeInSeconds();
+  long total = 0;
+  int farthest = 0, dots = 0;
+
+  if (DistanceLoad(&gDistances, &gWorld, path))
+    printf("Distance table read from %s", path);
+  else if (DistanceCreate(&gDistances, &gWorld)) {
+    printf("Distance table searched");
+    if (!DistanceSave(&gDistances, &gWorld, path))
+      printf(", could not save it to %s", path);
+  } else {
+    printf("The maze is too large for a distance table, at most %d nodes\n", maxDistanceNodes);
+    return;
   }
-
-  // check if the game ended
-  if (numDots < 1) {
-    returnToMenu(1);
+  printf(" - %d nodes in %.2f seconds\n", gDistances.numNodes, GetTimeInSeconds() - begin);
+
+  for (int n = 0; n < gWorld.numNodes; n++) {
+    const int d = Distance(&gDistances, start, n);
+    if ((gWorld.dot[n] || gWorld.ppill[n]) && (d != DistanceUnreachable)) {
+      farthest = std::max(farthest, d);
+      total += d;
+      dots++;
+    }
   }
+  if (dots > 0)
+    printf("Dots lie %.1f steps from the start on average, %d at most\n",
+	   (double) total / dots, farthest);
 }
 
-void checkCollision(void) {
-  for(int i = 0; i < 4; i++) {
-
-    //collision when they are on the same node
-    if (Man.cur == Ghosts[i].cur)
-      returnToMenu(-1);
-
-    //collision when pacman is moving to the ghosts node
-    if (Man.xMov > 0) {
-      if (Man.cur->nbor.right == Ghosts[i].cur)
-      returnToMenu(-1);
-    }
-    else if (Man.xMov < 0) {
-      if (Man.cur->nbor.left == Ghosts[i].cur)
-      returnToMenu(-1);
+/************ COMMAND LINE ***************/
+
+/* take our own options out of argv, leaving the rest for GLUT */
+void parseOptions(int *argc, char **argv) {
+  int kept = 1;
+
+  for (int i = 1; i < *argc; i++) {
+    if ((strcmp(argv[i], "-headless") == 0) && (i + 1 < *argc))
+      gHeadlessTicks = atol(argv[++i]);
+    else if ((strcmp(argv[i], "-threads") == 0) && (i + 1 < *argc))
+      gThreads = atoi(argv[++i]);
+    else if ((strcmp(argv[i], "-size") == 0) && (i + 1 < *argc))
+      gGridSize = atoi(argv[++i]);
+    else if (strcmp(argv[i], "-chase") == 0)
+      gChase = 1;
+    else if ((strcmp(argv[i], "-ghosts") == 0) && (i + 1 < *argc))
+      gNumGhosts = atoi(argv[++i]);
+    else if ((strcmp(argv[i], "-record") == 0) && (i + 1 < *argc))
+      gRecordFile = argv[++i];
+    else if ((strcmp(argv[i], "-replay") == 0) && (i + 1 < *argc))
+      gReplayFile = argv[++i];
+    else if (strcmp(argv[i], "-fast") == 0)
+      gReplayFast = 1;
+    else if ((strcmp(argv[i], "-autopilot") == 0) && (i + 1 < *argc)) {
+      gAutopilot = 1;
+      AutopilotSetBudget(atof(argv[++i]) / 1000.f);
     }
-    else if (Man.yMov < 0) {
-      if (Man.cur->nbor.down == Ghosts[i].cur)
-      returnToMenu(-1);
+    else if ((strcmp(argv[i], "-horizon") == 0) && (i + 1 < *argc))
+      AutopilotSetHorizon(atoi(argv[++i]));
+    else if ((strcmp(argv[i], "-batch") == 0) && (i + 1 < *argc))
+      gBatchGames = atoi(argv[++i]);
+    else if ((strcmp(argv[i], "-fps") == 0) && (i + 1 < *argc))
+      gTargetRate = atof(argv[++i]);
+    else if ((strcmp(argv[i], "-vsync") == 0) && (i + 1 < *argc)) {
+      i++;
+      if ((strcmp(argv[i], "on") != 0) && (strcmp(argv[i], "off") != 0)) {
+	fprintf(stderr, "Unknown option -vsync %s, it takes on or off\n", argv[i]);
+	exit(2);
+      }
+      gVsyncOption = (strcmp(argv[i], "on") == 0);
     }
-    else if (Man.yMov > 0) {
-      if (Man.cur->nbor.up == Ghosts[i].cur)
-      returnToMenu(-1);
+    else if ((strcmp(argv[i], "-profile") == 0) && (i + 1 < *argc))
+      gProfileFile = argv[++i];
+    else if ((strcmp(argv[i], "-renderbench") == 0) && (i + 1 < *argc))
+      gRenderFrames = atoi(argv[++i]);
+    else if ((strcmp(argv[i], "-out") == 0) && (i + 1 < *argc))
+      gOutFile = argv[++i];
+    else if ((strcmp(argv[i], "-seed") == 0) && (i + 1 < *argc)) {
+      gSeed = strtoul(argv[++i], NULL, 10);
+      gSeedGiven = 1;
     }
+    else if ((strcmp(argv[i], "-distances") == 0) && (i + 1 < *argc))
+      gDistanceFile = argv[++i];
+    else
+      argv[kept++] = argv[i];
   }
+  *argc = kept;
+
+  if (gGridSize < minGridSize)
+    gGridSize = minGridSize;
+  if (gGridSize > maxGridSize)
+    gGridSize = maxGridSize;
 }
 
 /************ GOOD OLD INT MAIN() ***************/
 
 int main(int argc, char **argv)
 {
-  /* Create the heightMap */
-  SetHeightMap();
+  parseOptions(&argc, argv);
+  ThreadPoolStart(gThreads);
+
+  /* Create the heightMap and the maze on top of it */
+  /* "-replay <file>" plays on the world and settings it was recorded with */
+  if (gReplayFile != NULL) {
+    if (!ReplayLoad(&gReplay, gReplayFile)) {
+      printf("Could not read a recording from %s\n", gReplayFile);
+      return 1;
+    }
+    gSeed = gReplay.header.seed;
+    gSeedGiven = 1;
+    gGridSize = gReplay.header.gridSize;
+    gNumGhosts = gReplay.header.numGhosts;
+    gChase = gReplay.header.chase;
+    gReplaying = 1;
+  }
+
+  if (!gSeedGiven)
+    gSeed = time(NULL);
+
+  /* "-batch <games>" plays whole games on worlds of their own */
+  if (gBatchGames > 0)
+    return RunBatch(gBatchGames);
+  WorldCreate(&gWorld, gSeed, gGridSize);
+  RandomSeed(&gAutopilotRandom, gSeed, RANDOM_INPUT);
+  xCenter = gWorld.gridSize / 2;
+  yCenter = gWorld.gridSize / 4;
+  FarZPlane = float (gWorld.gridSize*2);
   
   /* Test printout for the fractal
-    for(int x=0; x<gridSize; x++)
-    for(int y=0; y<gridSize; y++)
-    printf("heightMap[%d][%d] is %f\n", x, y, heightMap[x][y]);*/
+    for(int x=0; x<gWorld.gridSize; x++)
+    for(int y=0; y<gWorld.gridSize; y++)
+    printf("heightMap[%d][%d] is %f\n", x, y, WorldHeight(&gWorld, x, y));*/
   
-  /* Create adjacency list */
-  createAdjacencyList();
-  printf("Number of dots is %d\n", numDots);
+  printf("Seed %lu, number of dots is %d, regions in the maze %d\n",
+	 gWorld.seed, gWorld.numDots, gWorld.numComponents);
+
+  /* "-distances <file>" keeps a node to node distance table with the map */
+  if (gDistanceFile != NULL)
+    PrepareDistances(gDistanceFile);
+
+  /* "-renderbench <frames>" times the drawing without a window */
+  if (gRenderFrames > 0)
+    return RunRenderBench(gRenderFrames);
+
+  /* "-headless <ticks>" plays without opening a window */
+  if (gReplaying && gReplayFast)
+    return RunReplay();
+  if (gHeadlessTicks > 0)
+    return RunHeadless(gHeadlessTicks);
 
   /* create objects*/
-  createPacman();
-  createGhosts();
+  gState = GameCreate(&gWorld, gNumGhosts);
+  gState->chase = gChase;
+  gPreviousState = GameClone(gState);
+
+  /* "-record <file>" keeps every input until the window closes */
+  if (gRecordFile != NULL) {
+    if (ReplayRecordStart(gRecordFile, gState))
+      atexit(finishRecording);
+    else
+      printf("Could not record to %s\n", gRecordFile);
+  }
+
+  /* "-profile <file>" keeps the last frames' timings when the window closes */
+  if (gProfileFile != NULL)
+    atexit(writeProfile);
 
   /* Initialise GLUT - our window, our callbacks, etc */
   InitialiseGLUT(argc, argv);
 
   /* Do any one-time openGl initialisation that we might require */
   InitialiseOpenGL();
+  if (!GpuTimerCreate())
+    printf("No GPU timer queries, the profile has CPU times only\n");
 
   /* Start up our timer. */
   InitialiseTimer();
@@ -1503,8 +1607,11 @@ int main(int argc, char **argv)
   /* Start drawing the scene */
   InitialiseScene();
 
-  /* Enter the main loop */
-  glutIdleFunc(UpdateFrame);
+  /* Enter the main loop - frames come from a timer the pacer sets, so
+     GLUT sleeps in between and still wakes for the keyboard */
+  initialiseVsync();
+  PacerStart(gTargetRate);
+  glutTimerFunc(0, frameTimer, gTimerGeneration);
   glutMainLoop();
 
   /* when the window closes, we will end up here. */
@@ -0,0 +1,240 @@
+/************ HEADERS ***************/
+
+/* Ordinary C stuff */
+#include <stdio.h>
+#include <string.h>
+
+#include "Profile.h"
+#include "Timer.h"
+
+/************ GLOBALS AND DEFINES ***************/
+
+const char *profilePhaseNames[PROFILE_PHASES] = {
+  "tick", "terrain", "dots", "fruits", "ghosts", "text", "swap"
+};
+
+/* one frame of the ring */
+typedef struct profileFrame {
+  double start;				/* GetTimeInSeconds when it began */
+  float seconds;			/* until the next frame began */
+  double phaseStart[PROFILE_PHASES];	/* first time each phase began */
+  float phaseSeconds[PROFILE_PHASES];	/* all the time spent in it */
+  float gpuSeconds[PROFILE_PHASES];	/* GPU time, -1 until reported */
+} ProfileFrame;
+
+static ProfileFrame gFrames[profileFrames];
+
+/* the frame being recorded, and how many frames have finished */
+static int gCurrent = -1;
+static long gFinished = 0;
+
+/* when each phase last began, while it runs */
+static double gPhaseBegan[PROFILE_PHASES];
+
+/************ FUNCTION PROTOTYPES ***************/
+
+int oldestFrame(int *count);
+ProfileFrame *frameNumbered(long frame);
+
+/************ RECORDING ***************/
+
+void ProfileNextFrame(void)
+{
+  const double now = GetTimeInSeconds();
+
+  if (gCurrent >= 0) {
+    gFrames[gCurrent].seconds = now - gFrames[gCurrent].start;
+    gFinished++;
+  }
+  gCurrent = (gCurrent + 1) % profileFrames;
+  memset(&gFrames[gCurrent], 0, sizeof(ProfileFrame));
+  gFrames[gCurrent].start = now;
+  for (int p = 0; p < PROFILE_PHASES; p++)
+    gFrames[gCurrent].gpuSeconds[p] = -1.f;
+}
+
+long ProfileFrameNumber(void)
+{
+  return gFinished;
+}
+
+void ProfileBegin(int phase)
+{
+  gPhaseBegan[phase] = GetTimeInSeconds();
+}
+
+void ProfileEnd(int phase)
+{
+  ProfileFrame *frame;
+
+  // anything before the first frame is not kept
+  if (gCurrent < 0)
+    return;
+  frame = &gFrames[gCurrent];
+  if (frame->phaseSeconds[phase] == 0.f)
+    frame->phaseStart[phase] = gPhaseBegan[phase];
+  frame->phaseSeconds[phase] += GetTimeInSeconds() - gPhaseBegan[phase];
+}
+
+/* a frame by its number, NULL once the ring has moved past it */
+ProfileFrame *frameNumbered(long frame)
+{
+  if ((gCurrent < 0) || (frame > gFinished) || (frame <= gFinished - profileFrames))
+    return NULL;
+  return &gFrames[(gCurrent - (int) (gFinished - frame) + profileFrames) % profileFrames];
+}
+
+void ProfileGpuTime(long frame, int phase, float seconds)
+{
+  ProfileFrame *earlier = frameNumbered(frame);
+
+  if (earlier != NULL)
+    earlier->gpuSeconds[phase] = seconds;
+}
+
+float ProfileFrameGpu(long frame)
+{
+  const ProfileFrame *earlier = frameNumbered(frame);
+  float total = 0.f;
+  int reported = 0;
+
+  if (earlier == NULL)
+    return -1.f;
+  for (int p = 0; p < PROFILE_PHASES; p++)
+    if (earlier->gpuSeconds[p] >= 0.f) {
+      total += earlier->gpuSeconds[p];
+      reported = 1;
+    }
+  return reported ? total : -1.f;
+}
+
+/************ STATISTICS ***************/
+
+/* the oldest finished frame in the ring, and how many there are */
+int oldestFrame(int *count)
+{
+  *count = (gFinished < profileFrames - 1) ? (int) gFinished : profileFrames - 1;
+  return (gCurrent - *count + profileFrames) % profileFrames;
+}
+
+int ProfilePhaseStats(int phase, float *mean, float *max)
+{
+  int count;
+  const int first = oldestFrame(&count);
+  double total = 0.;
+
+  *mean = *max = 0.f;
+  for (int i = 0; i < count; i++) {
+    const float seconds = gFrames[(first + i) % profileFrames].phaseSeconds[phase];
+    total += seconds;
+    if (seconds > *max)
+      *max = seconds;
+  }
+  if (count > 0)
+    *mean = total / count;
+  return count;
+}
+
+int ProfileGpuStats(int phase, float *mean, float *max)
+{
+  int count, reported = 0;
+  const int first = oldestFrame(&count);
+  double total = 0.;
+
+  *mean = *max = 0.f;
+  for (int i = 0; i < count; i++) {
+    const float seconds = gFrames[(first + i) % profileFrames].gpuSeconds[phase];
+    if (seconds < 0.f)
+      continue;
+    total += seconds;
+    reported++;
+    if (seconds > *max)
+      *max = seconds;
+  }
+  if (reported > 0)
+    *mean = total / reported;
+  return reported;
+}
+
+int ProfileFrameStats(float *mean, float *max)
+{
+  int count;
+  const int first = oldestFrame(&count);
+  double total = 0.;
+
+  *mean = *max = 0.f;
+  for (int i = 0; i < count; i++) {
+    const float seconds = gFrames[(first + i) % profileFrames].seconds;
+    total += seconds;
+    if (seconds > *max)
+      *max = seconds;
+  }
+  if (count > 0)
+    *mean = total / count;
+  return count;
+}
+
+/************ EXPORT ***************/
+
+/*
+  Complete events in microseconds from the oldest frame - the frames on
+  one track and the phases, where they began, on another, with their
+  GPU time as an argument.
+*/
+void ProfileWriteTrace(FILE *file)
+{
+  int count;
+  const int first = oldestFrame(&count);
+  const double origin = gFrames[first].start;
+  const char *separator = "";
+
+  fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+  for (int i = 0; i < count; i++) {
+    const ProfileFrame *frame = &gFrames[(first + i) % profileFrames];
+
+    fprintf(file, "%s{\"name\":\"frame\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":%.1f,\"dur\":%.1f}",
+	    separator, (frame->start - origin) * 1e6, frame->seconds * 1e6);
+    separator = ",\n";
+    for (int p = 0; p < PROFILE_PHASES; p++) {
+      if (frame->phaseSeconds[p] <= 0.f)
+	continue;
+      fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":2,\"ts\":%.1f,\"dur\":%.1f",
+	      profilePhaseNames[p], (frame->phaseStart[p] - origin) * 1e6, frame->phaseSeconds[p] * 1e6);
+      // the GPU ran the phase some time later, only its length is known
+      if (frame->gpuSeconds[p] >= 0.f)
+	fprintf(file, ",\"args\":{\"gpu_us\":%.1f}", frame->gpuSeconds[p] * 1e6);
+      fprintf(file, "}");
+    }
+  }
+  fprintf(file, "\n]}\n");
+}
+
+/* milliseconds, one line a frame - GPU columns are empty where no time
+   was reported */
+void ProfileWriteCSV(FILE *file)
+{
+  int count;
+  const int first = oldestFrame(&count);
+  const double origin = gFrames[first].start;
+
+  fprintf(file, "frame,start_ms,frame_ms");
+  for (int p = 0; p < PROFILE_PHASES; p++)
+    fprintf(file, ",%s_ms", profilePhaseNames[p]);
+  for (int p = 0; p < PROFILE_PHASES; p++)
+    fprintf(file, ",%s_gpu_ms", profilePhaseNames[p]);
+  fprintf(file, "\n");
+
+  for (int i = 0; i < count; i++) {
+    const ProfileFrame *frame = &gFrames[(first + i) % profileFrames];
+
+    fprintf(file, "%ld,%.3f,%.3f", gFinished - count + i, (frame->start - origin) * 1e3, frame->seconds * 1e3);
+    for (int p = 0; p < PROFILE_PHASES; p++)
+      fprintf(file, ",%.3f", frame->phaseSeconds[p] * 1e3);
+    for (int p = 0; p < PROFILE_PHASES; p++)
+      if (frame->gpuSeconds[p] >= 0.f)
+	fprintf(file, ",%.3f", frame->gpuSeconds[p] * 1e3);
+      else
+	fprintf(file, ",");
+    fprintf(file, "\n");
+  }
+}
@@ -0,0 +1,73 @@
+#ifndef Profile_h
+#define Profile_h
+
+/*
+ Where the time of a frame goes.
+
+ The front end brackets each phase of a frame - the simulation ticks,
+ the terrain, dots, fruits and ghosts, the text over the scene and the
+ buffer swap - with ProfileBegin and ProfileEnd, and starts every frame
+ with ProfileNextFrame. A phase entered more than once in a frame, as
+ the ticks are, adds up. The last profileFrames frames are kept in a
+ ring buffer, each with its start, its length up to the next frame and
+ the time of every phase, so the front end can draw the averages over
+ the scene and write the whole ring out when it is done, either as a
+ Chrome trace (load it in chrome://tracing or Perfetto) or as CSV.
+
+ The timers read the same monotonic clock as Timer.c, two reads a
+ phase, and are always on.
+
+ GL calls only queue work, so the CPU time of a drawing phase says
+ little about what the GPU spent on it. GpuTimer measures that with
+ queries and hands each result back, frames later, to
+ ProfileGpuTime, which files it with the frame it was measured in.
+ */
+
+#include <stdio.h>
+
+/* the phases of a frame */
+enum {
+  PROFILE_TICK,		/* GameStep, however many ticks the frame runs */
+  PROFILE_TERRAIN,
+  PROFILE_DOTS,
+  PROFILE_FRUITS,
+  PROFILE_GHOSTS,
+  PROFILE_TEXT,		/* score, menu and this overlay */
+  PROFILE_SWAP,
+  PROFILE_PHASES
+};
+
+/* frames kept, ten seconds at 60 frames a second */
+#define profileFrames 600
+
+extern const char *profilePhaseNames[PROFILE_PHASES];
+
+/* close the current frame and start the next */
+void ProfileNextFrame(void);
+
+/* the number of the frame being recorded, counting from 0 */
+long ProfileFrameNumber(void);
+
+void ProfileBegin(int phase);
+void ProfileEnd(int phase);
+
+/* GPU seconds of a phase in an earlier frame, dropped if the frame has
+   left the ring */
+void ProfileGpuTime(long frame, int phase, float seconds);
+
+/* GPU seconds of all the phases of a frame, -1 if none were reported */
+float ProfileFrameGpu(long frame);
+
+/* mean and worst seconds of a phase, and of whole frames, over the
+   finished frames in the ring - returns how many there were */
+int ProfilePhaseStats(int phase, float *mean, float *max);
+int ProfileFrameStats(float *mean, float *max);
+
+/* the same for the GPU time of a phase, over the frames it was reported for */
+int ProfileGpuStats(int phase, float *mean, float *max);
+
+/* the ring as a Chrome trace, or as CSV with one line a frame */
+void ProfileWriteTrace(FILE *file);
+void ProfileWriteCSV(FILE *file);
+
+#endif
@@ -0,0 +1,112 @@
+/************ HEADERS ***************/
+
+#include "Random.h"
+
+/************ FUNCTION PROTOTYPES ***************/
+
+unsigned long long splitMix(unsigned long long *x);
+static inline unsigned long long rotl(unsigned long long x, int k);
+
+/************ COUNTER BASED STREAMS ***************/
+
+/*
+  A random number in [0, 1] that depends only on the seed, the stream
+  and the point it is used for, never on the order points are visited in.
+*/
+float RandomAt(unsigned long seed, int stream, int x, int y)
+{
+  unsigned long long h = (unsigned long long) seed * 0x9E3779B97F4A7C15ULL;
+
+  h ^= (unsigned long long) stream * 0xD1B54A32D192ED03ULL;
+  h ^= ((unsigned long long) x << 32) | (unsigned int) y;
+  h = (h ^ (h >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  h = (h ^ (h >> 27)) * 0x94D049BB133111EBULL;
+  h ^= h >> 31;
+  return (float) (h >> 40) / (float) ((1 << 24) - 1);
+}
+
+/************ SEQUENTIAL STREAMS ***************/
+
+/* the splitmix64 step, used to spread a seed over the generator state */
+unsigned long long splitMix(unsigned long long *x)
+{
+  unsigned long long z = (*x += 0x9E3779B97F4A7C15ULL);
+
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+static inline unsigned long long rotl(unsigned long long x, int k)
+{
+  return (x << k) | (x >> (64 - k));
+}
+
+/* start the sequence of a stream */
+void RandomSeed(Random *rng, unsigned long seed, int stream)
+{
+  unsigned long long x = (unsigned long long) seed ^
+    ((unsigned long long) stream * 0xD1B54A32D192ED03ULL);
+
+  for (int i = 0; i < 4; i++)
+    rng->s[i] = splitMix(&x);
+}
+
+/* xoshiro256** */
+unsigned long long RandomNext(Random *rng)
+{
+  unsigned long long *s = rng->s;
+  const unsigned long long result = rotl(s[1] * 5, 7) * 9;
+  const unsigned long long t = s[1] << 17;
+
+  s[2] ^= s[0];
+  s[3] ^= s[1];
+  s[1] ^= s[2];
+  s[0] ^= s[3];
+  s[2] ^= t;
+  s[3] = rotl(s[3], 45);
+  return result;
+}
+
+/* an integer in [0, n) from the top bits, by multiplying rather than dividing */
+int RandomBelow(Random *rng, int n)
+{
+  return (int) (((RandomNext(rng) >> 32) * (unsigned long long) n) >> 32);
+}
+
+/* a float in [0, 1) */
+float RandomFloat(Random *rng)
+{
+  return (float) (RandomNext(rng) >> 40) / (float) (1 << 24);
+}
+
+/* skip 2^128 numbers ahead */
+void RandomJump(Random *rng)
+{
+  static const unsigned long long jump[4] = {
+    0x180ec6d33cfd0abaULL, 0xd5a61266f0c9392cULL,
+    0xa9582618e03fc9aaULL, 0x39abdc4529b1661cULL
+  };
+  unsigned long long s[4] = { 0, 0, 0, 0 };
+
+  for (int i = 0; i < 4; i++) {
+    for (int b = 0; b < 64; b++) {
+      if (jump[i] & (1ULL << b)) {
+	s[0] ^= rng->s[0];
+	s[1] ^= rng->s[1];
+	s[2] ^= rng->s[2];
+	s[3] ^= rng->s[3];
+      }
+      RandomNext(rng);
+    }
+  }
+  for (int i = 0; i < 4; i++)
+    rng->s[i] = s[i];
+}
+
+/* give to the sequence from is on, and move from past it */
+void RandomSplit(Random *from, Random *to)
+{
+  *to = *from;
+  RandomJump(from);
+}
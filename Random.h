@@ -0,0 +1,52 @@
+#ifndef Random_h
+#define Random_h
+
+/*
+ Random numbers for pacman.
+
+ Every part of the game that needs random numbers draws them from its
+ own stream, picked by the world seed and one of the RANDOM_* stream
+ numbers, so the terrain, its colours and the ghosts never take
+ numbers from each other and the same seed always gives the same
+ world and the same game.
+
+ There are two kinds of stream. RandomAt is counter based - the
+ number for a point (x, y) of a stream is a hash of the seed, the
+ stream and the point, so work split over threads gets the same
+ numbers whichever thread does which part. A Random is a xoshiro256**
+ generator for things that happen in sequence, like the ghosts
+ turning. It is plain data, so it lives in a GameState and is copied
+ with it. RandomJump skips it ahead 2^128 numbers; RandomSplit uses
+ that to hand out sequences that never overlap, one per thread or per
+ game.
+ */
+
+/* stream numbers */
+#define RANDOM_TERRAIN 0	/* heights of the fractal */
+#define RANDOM_COLOUR  1	/* shades of the terrain */
+#define RANDOM_SPAWN   2	/* where extra ghosts start */
+#define RANDOM_GHOSTS  3	/* ghosts turning at random */
+#define RANDOM_INPUT   4	/* pacman's moves when nobody plays */
+
+typedef struct randomState {
+  unsigned long long s[4];
+} Random;
+
+/* the number in [0, 1] for the point (x, y) of a stream */
+float RandomAt(unsigned long seed, int stream, int x, int y);
+
+/* start the sequence of a stream */
+void RandomSeed(Random *rng, unsigned long seed, int stream);
+
+/* the next 64 random bits, an integer in [0, n) and a float in [0, 1) */
+unsigned long long RandomNext(Random *rng);
+int RandomBelow(Random *rng, int n);
+float RandomFloat(Random *rng);
+
+/* skip 2^128 numbers ahead */
+void RandomJump(Random *rng);
+
+/* give to the sequence from is on, and move from past it */
+void RandomSplit(Random *from, Random *to);
+
+#endif
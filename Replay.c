@@ -0,0 +1,173 @@
+/************ HEADERS ***************/
+
+/* Ordinary C stuff */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Replay.h"
+
+/************ GLOBALS AND DEFINES ***************/
+
+static const char replayMagic[4] = { 'P', 'M', 'R', 'C' };
+static const char endingMagic[4] = { 'E', 'N', 'D', '.' };
+static const int replayVersion = 1;
+
+/* the recording being written */
+static FILE *gRecording = NULL;
+
+/************ FUNCTION PROTOTYPES ***************/
+
+void fillEnding(ReplayEnding *ending, const GameState *game);
+
+/************ RECORDING ***************/
+
+/* open path and write the settings of game, before its first step */
+int ReplayRecordStart(const char *path, const GameState *game)
+{
+  ReplayHeader header;
+
+  gRecording = fopen(path, "wb");
+  if (gRecording == NULL)
+    return 0;
+
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, replayMagic, sizeof(replayMagic));
+  header.version = replayVersion;
+  header.seed = game->world->seed;
+  header.gridSize = game->world->gridSize;
+  header.numGhosts = game->numGhosts;
+  header.chase = game->chase;
+  fwrite(&header, sizeof(header), 1, gRecording);
+  return 1;
+}
+
+/* note the input given on tick, if there was any */
+void ReplayRecordInput(int tick, const GameInput *input)
+{
+  ReplayInput entry;
+
+  if ((gRecording == NULL) || ((input->xMov == 0) && (input->yMov == 0) && !input->start))
+    return;
+
+  entry.tick = tick;
+  entry.xMov = input->xMov;
+  entry.yMov = input->yMov;
+  entry.start = input->start;
+  entry.reserved = 0;
+  fwrite(&entry, sizeof(entry), 1, gRecording);
+}
+
+/* write how the game ended and close the file */
+void ReplayRecordFinish(const GameState *game)
+{
+  ReplayEnding ending;
+
+  if (gRecording == NULL)
+    return;
+
+  fillEnding(&ending, game);
+  fwrite(&ending, sizeof(ending), 1, gRecording);
+  fclose(gRecording);
+  gRecording = NULL;
+}
+
+void fillEnding(ReplayEnding *ending, const GameState *game)
+{
+  memset(ending, 0, sizeof(ReplayEnding));
+  memcpy(ending->magic, endingMagic, sizeof(endingMagic));
+  ending->tick = game->tick;
+  ending->score = game->score;
+  ending->numDots = game->numDots;
+  ending->gameWin = game->gameWin;
+  ending->checksum = GameChecksum(game);
+}
+
+/************ PLAYING BACK ***************/
+
+/* read a whole recording - 0 if missing or damaged */
+int ReplayLoad(Replay *replay, const char *path)
+{
+  FILE *file = fopen(path, "rb");
+  long size;
+  size_t entries;
+
+  memset(replay, 0, sizeof(Replay));
+  if (file == NULL)
+    return 0;
+
+  fseek(file, 0, SEEK_END);
+  size = ftell(file);
+  fseek(file, 0, SEEK_SET);
+  if ((size < (long) (sizeof(ReplayHeader) + sizeof(ReplayEnding))) ||
+      ((size - sizeof(ReplayHeader) - sizeof(ReplayEnding)) % sizeof(ReplayInput) != 0)) {
+    fclose(file);
+    return 0;
+  }
+
+  // the inputs are whatever lies between the header and the ending
+  entries = (size - sizeof(ReplayHeader) - sizeof(ReplayEnding)) / sizeof(ReplayInput);
+  replay->numInputs = entries;
+  replay->inputs = (ReplayInput *) malloc((entries > 0 ? entries : 1) * sizeof(ReplayInput));
+  if ((fread(&replay->header, sizeof(ReplayHeader), 1, file) != 1) ||
+      (fread(replay->inputs, sizeof(ReplayInput), entries, file) != entries) ||
+      (fread(&replay->ending, sizeof(ReplayEnding), 1, file) != 1) ||
+      (memcmp(replay->header.magic, replayMagic, sizeof(replayMagic)) != 0) ||
+      (replay->header.version != replayVersion) ||
+      (memcmp(replay->ending.magic, endingMagic, sizeof(endingMagic)) != 0) ||
+      // settings the game could never have been played with
+      (replay->header.gridSize < minGridSize) ||
+      (replay->header.gridSize > maxGridSize) ||
+      (replay->header.numGhosts < 1) ||
+      (replay->header.numGhosts > maxNumGhosts) ||
+      ((replay->header.chase != 0) && (replay->header.chase != 1))) {
+    fclose(file);
+    ReplayFree(replay);
+    return 0;
+  }
+
+  fclose(file);
+  return 1;
+}
+
+void ReplayFree(Replay *replay)
+{
+  free(replay->inputs);
+  replay->inputs = NULL;
+  replay->numInputs = 0;
+}
+
+/* the input for tick, taken in order, (0, 0) if it had none */
+void ReplayNextInput(Replay *replay, int tick, GameInput *input)
+{
+  input->xMov = 0;
+  input->yMov = 0;
+  input->start = 0;
+
+  // inputs are in tick order, so only the next one can be due
+  while ((replay->next < replay->numInputs) && ((int) replay->inputs[replay->next].tick < tick))
+    replay->next++;
+  if ((replay->next < replay->numInputs) && ((int) replay->inputs[replay->next].tick == tick)) {
+    input->xMov = replay->inputs[replay->next].xMov;
+    input->yMov = replay->inputs[replay->next].yMov;
+    input->start = replay->inputs[replay->next].start;
+    replay->next++;
+  }
+}
+
+/* does game end where the recording did - prints what differs if not */
+int ReplayMatches(const Replay *replay, const GameState *game)
+{
+  const ReplayEnding *want = &replay->ending;
+  ReplayEnding got;
+
+  fillEnding(&got, game);
+  if (memcmp(&got, want, sizeof(ReplayEnding)) == 0)
+    return 1;
+
+  printf("Replay differs - recorded tick %d score %d dots %d result %d state %016llx\n",
+	 want->tick, want->score, want->numDots, want->gameWin, want->checksum);
+  printf("                 replayed tick %d score %d dots %d result %d state %016llx\n",
+	 got.tick, got.score, got.numDots, got.gameWin, got.checksum);
+  return 0;
+}
@@ -0,0 +1,77 @@
+#ifndef Replay_h
+#define Replay_h
+
+/*
+ Recording games and playing them back.
+
+ A game is decided by its world, its settings and the input given on
+ each tick, so that is all a recording holds. It is a small binary
+ file: a header with the seed, map size, ghost count and chase mode,
+ then one 8 byte entry for every tick that had input, then an ending
+ with the tick count, score, dots left, result and GameChecksum of
+ the final state.
+
+ Playing it back builds the same world, feeds the same input to
+ GameStep on the same ticks and compares the end with the recorded
+ one. That works at any speed, in a window or headless, so a
+ recording both reproduces a game someone reported and serves as a
+ fixed workload to time.
+ */
+
+#include "Game.h"
+
+/* the settings a recorded game was played with */
+typedef struct replayHeader {
+  char magic[4];
+  int version;
+  unsigned long long seed;
+  int gridSize;
+  int numGhosts;
+  int chase;
+  int reserved;
+} ReplayHeader;
+
+/* input given on one tick */
+typedef struct replayInput {
+  unsigned int tick;
+  signed char xMov;
+  signed char yMov;
+  unsigned char start;
+  unsigned char reserved;
+} ReplayInput;
+
+/* how a recorded game ended */
+typedef struct replayEnding {
+  char magic[4];
+  int tick;
+  int score;
+  int numDots;
+  int gameWin;
+  int reserved;
+  unsigned long long checksum;
+} ReplayEnding;
+
+typedef struct replay {
+  ReplayHeader header;
+  int numInputs;
+  ReplayInput *inputs;
+  ReplayEnding ending;
+  int next;		/* first input not played yet */
+} Replay;
+
+/* recording - one game at a time, written as it is played */
+int ReplayRecordStart(const char *path, const GameState *game);
+void ReplayRecordInput(int tick, const GameInput *input);
+void ReplayRecordFinish(const GameState *game);
+
+/* read a whole recording - 0 if missing or damaged */
+int ReplayLoad(Replay *replay, const char *path);
+void ReplayFree(Replay *replay);
+
+/* the input for tick, taken in order, (0, 0) if it had none */
+void ReplayNextInput(Replay *replay, int tick, GameInput *input);
+
+/* does game end where the recording did - prints what differs if not */
+int ReplayMatches(const Replay *replay, const GameState *game);
+
+#endif
@@ -0,0 +1,462 @@
+/************ HEADERS ***************/
+
+/* Ordinary C stuff */
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+
+/* Maths library - remember to use -lm if building with GCC */
+#include <math.h>
+
+/* GL headers - with the prototypes for buffer objects */
+#define GL_GLEXT_PROTOTYPES
+#include </usr/include/GL/gl.h>
+
+#include "Terrain.h"
+#include "ThreadPool.h"
+
+/************ GLOBALS AND DEFINES ***************/
+
+/* one vertex per heightMap sample, interleaved in a single buffer */
+typedef struct terrainVertex {
+  float x, y, z;
+  float nx, ny, nz;
+  float r, g, b;
+} TerrainVertex;
+
+/* quads along one edge of a chunk, and the number of detail levels -
+   level l keeps every (1 << l)th sample, down to two triangles */
+static const int chunkQuads = 64;
+static const int chunkSamples = chunkQuads + 1;
+static const int numLevels = 7;
+
+/* vertex layout of a chunk - the grid first, x major, then the bottom
+   vertex of the skirt under each sample of its four edges */
+static const int chunkGridVertices = chunkSamples * chunkSamples;
+static const int chunkVertices = chunkGridVertices + 4 * chunkSamples;
+
+/* the largest error in pixels a coarser level may show on screen */
+static const float maxPixelError = 2.0;
+
+typedef struct terrainChunk {
+  int x, z;			/* first sample of the chunk */
+  float minY, maxY;		/* height of its bounding box */
+  float skirt;			/* how far interior skirts hang down */
+  float error[numLevels];	/* largest height error of each level */
+} TerrainChunk;
+
+static int gGridSize = 0;
+static int gChunksPerLine = 0;
+static int gNumChunks = 0;
+static TerrainChunk *gChunks = NULL;
+static TerrainVertex *gVertices = NULL;
+
+/* one index buffer shared by every chunk, a surface and a skirt strip per level */
+static GLuint gVertexBuffer = 0;
+static GLuint gIndexBuffer = 0;
+static int gLevelFirst[numLevels];
+static int gLevelSurface[numLevels];
+static int gLevelSkirt[numLevels];
+static int gLevelTriangles[numLevels];
+
+/* the colour of the sides */
+static const float sideColor[3] = { 0.3, 0.3, 0.1 };
+
+/************ FUNCTION PROTOTYPES ***************/
+
+float heightAt(const World *world, int x, int z);
+void setColor(TerrainVertex *v, const World *world, float color_val, int x, int z);
+void buildGridVertex(TerrainVertex *v, const World *world, int x, int z);
+float levelError(const World *world, const TerrainChunk *chunk, int step);
+void buildChunk(const World *world, int chunk);
+void buildChunkTask(void *context, int task);
+int buildIndices(GLushort *indices);
+int chooseLevel(const TerrainChunk *chunk, const float eye[3], float pixelScale);
+
+/************ VERTICES ***************/
+
+/* heightMap value, clamped to the edges of the map */
+float heightAt(const World *world, int x, int z) {
+  if (x < 0) x = 0;
+  if (x > gGridSize - 1) x = gGridSize - 1;
+  if (z < 0) z = 0;
+  if (z > gGridSize - 1) z = gGridSize - 1;
+  return WorldHeight(world, x, z);
+}
+
+/*
+  set the colors of terrain - the shade comes from the position, so a
+  sample shared by two chunks gets the same colour in both
+*/
+void setColor(TerrainVertex *v, const World *world, float color_val, int x, int z) {
+  float r1 = RandomAt(world->seed, RANDOM_COLOUR, x, z);
+
+  // snow
+  if(color_val > world->snowThreshold ) {
+    v->r = 0.9f;
+    v->g = 0.9f;
+    v->b = 0.9f;
+  }
+  // mountain
+  else if(color_val > ((float) (gGridSize/2) * 0.70f) && color_val > world->waterThreshold) {
+    r1 = 0.2f + (r1 * 0.2f);
+    v->r = r1;
+    v->g = r1 / 2.0f;
+    v->b = 0.0f;
+  }
+  // grass
+  else if(color_val > ((float) (gGridSize/2) * 0.30f) && color_val > world->waterThreshold) {
+    r1 = 0.5f + (r1 * 0.2f);
+    v->r = 0.0f;
+    v->g = r1;
+    v->b = 0.0f;
+  }
+  // soil
+  else if(color_val > world->waterThreshold ){
+    r1 = 0.5f + (r1 * 0.2f);
+    v->r = r1;
+    v->g = r1;
+    v->b = r1 / 5.0f;
+  }
+  // water surface, already levelled by the world
+  else {
+    v->r = 0.0f;
+    v->g = 0.0f;
+    v->b = 0.7f;
+  }
+}
+
+/* position, normal and colour of the sample at (x, z) */
+void buildGridVertex(TerrainVertex *v, const World *world, int x, int z) {
+  v->x = x;
+  v->y = WorldHeight(world, x, z);
+  v->z = z;
+
+  /* Calculating the normal vector
+     The 4 vectors surrounding the vertex is
+     v1 (1, heightMap[x+1][z] - heightMap[x][z], 0)
+     v2 (0, heightMap[x][z+1] - heightMap[x][z], 1)
+     v3 (-1, heightMap[x-1][z] - heightMap[x][z], 0)
+     v4 (0, heightMap[x][z-1] - heightMap[x][z], -1)
+     and summing their cross products leaves
+     sum (-2 * heightMap[x-1][z] - heightMap[x][z],
+          -4, 2 * heightMap[x][z+1] - heightMap[x][z-1])
+  */
+  v->nx = -2 * (heightAt(world, x-1, z) - heightAt(world, x, z));
+  v->ny = -4;
+  v->nz = 2 * (heightAt(world, x, z+1) - heightAt(world, x, z-1));
+
+  setColor(v, world, v->y, x, z);
+}
+
+/*
+  Largest vertical distance between the full detail surface of a chunk
+  and the surface drawn when only every step'th sample is kept. The
+  coarse cells are split along the same diagonal as the strips.
+*/
+float levelError(const World *world, const TerrainChunk *chunk, int step) {
+  float error = 0.;
+
+  for (int cx = 0; cx < chunkQuads; cx += step) {
+    for (int cz = 0; cz < chunkQuads; cz += step) {
+      float h00 = heightAt(world, chunk->x + cx, chunk->z + cz);
+      float h10 = heightAt(world, chunk->x + cx + step, chunk->z + cz);
+      float h01 = heightAt(world, chunk->x + cx, chunk->z + cz + step);
+      float h11 = heightAt(world, chunk->x + cx + step, chunk->z + cz + step);
+
+      for (int u = 0; u <= step; u++) {
+	for (int v = 0; v <= step; v++) {
+	  float fu = (float) u / step, fv = (float) v / step;
+	  float coarse = (fu + fv <= 1.) ?
+	    h00 + fu * (h10 - h00) + fv * (h01 - h00) :
+	    h11 + (1. - fu) * (h01 - h11) + (1. - fv) * (h10 - h11);
+	  float d = fabs(heightAt(world, chunk->x + cx + u, chunk->z + cz + v) - coarse);
+	  if (d > error)
+	    error = d;
+	}
+      }
+    }
+  }
+  return error;
+}
+
+/*
+  Build the vertices, bounds and level errors of one chunk. Samples
+  past the far edges of the map are clamped onto the edge, so the
+  chunks there keep the common layout and the extra quads have no area.
+*/
+void buildChunk(const World *world, int chunk) {
+  TerrainChunk *c = &gChunks[chunk];
+  TerrainVertex *v = &gVertices[(size_t) chunk * chunkVertices];
+  const int limit = gGridSize - 1;
+  /* first sample and step of each edge: z = 0, x = max, z = max, x = 0 */
+  const int edges[4][4] = {
+    { 0, 0, 1, 0 },
+    { chunkQuads, 0, 0, 1 },
+    { 0, chunkQuads, 1, 0 },
+    { 0, 0, 0, 1 }
+  };
+  /* outward normal of the edges that lie on the sides of the block */
+  const float sideNormal[4][2] = { { 0, -1 }, { 1, 0 }, { 0, 1 }, { -1, 0 } };
+  int onSide[4];
+
+  c->x = (chunk / gChunksPerLine) * chunkQuads;
+  c->z = (chunk % gChunksPerLine) * chunkQuads;
+  c->minY = c->maxY = WorldHeight(world, c->x, c->z);
+
+  for (int cx = 0; cx < chunkSamples; cx++) {
+    for (int cz = 0; cz < chunkSamples; cz++) {
+      TerrainVertex *g = &v[cx * chunkSamples + cz];
+      buildGridVertex(g, world, std::min(c->x + cx, limit), std::min(c->z + cz, limit));
+      if (g->y < c->minY) c->minY = g->y;
+      if (g->y > c->maxY) c->maxY = g->y;
+    }
+  }
+
+  // the error of a level never drops below the finer one
+  c->error[0] = 0.;
+  for (int l = 1; l < numLevels; l++)
+    c->error[l] = std::max(levelError(world, c, 1 << l), c->error[l - 1]);
+
+  // interior skirts only need to cover the largest crack a neighbour can leave
+  c->skirt = c->error[numLevels - 1] + 1.;
+  onSide[0] = (c->z == 0);
+  onSide[1] = (c->x + chunkQuads >= limit);
+  onSide[2] = (c->z + chunkQuads >= limit);
+  onSide[3] = (c->x == 0);
+
+  for (int e = 0; e < 4; e++) {
+    for (int i = 0; i < chunkSamples; i++) {
+      int cx = edges[e][0] + edges[e][2] * i;
+      int cz = edges[e][1] + edges[e][3] * i;
+      const TerrainVertex *top = &v[cx * chunkSamples + cz];
+      TerrainVertex *bottom = &v[chunkGridVertices + e * chunkSamples + i];
+
+      *bottom = *top;
+      if (onSide[e]) {
+	// the side of the terrain block, down to the ground
+	bottom->y = 0.;
+	bottom->nx = sideNormal[e][0];
+	bottom->ny = 0.;
+	bottom->nz = sideNormal[e][1];
+	bottom->r = sideColor[0];
+	bottom->g = sideColor[1];
+	bottom->b = sideColor[2];
+      } else {
+	bottom->y = top->y - c->skirt;
+      }
+    }
+  }
+  if (onSide[0] || onSide[1] || onSide[2] || onSide[3])
+    c->minY = 0.;
+  else
+    c->minY -= c->skirt;
+}
+
+void buildChunkTask(void *context, int task) {
+  buildChunk((const World *) context, task);
+}
+
+/************ INDICES ***************/
+
+/*
+  Fill the index buffer shared by every chunk. Each level has one
+  strip over the grid, a row pair at a time, and one strip around the
+  skirts. Consecutive rows are joined by repeating the last and first
+  index, which makes triangles with no area. Returns the number of
+  indices written.
+*/
+int buildIndices(GLushort *indices) {
+  int n = 0;
+
+  for (int l = 0; l < numLevels; l++) {
+    const int step = 1 << l;
+    const int quads = chunkQuads / step;
+
+    /* Triangles (x,z) (x+s,z) (x, z+s) and (x+s,z) (x,z+s) (x+s,z+s) */
+    gLevelFirst[l] = n;
+    for (int x = 0; x < chunkQuads; x += step) {
+      if (x > 0)
+	indices[n++] = x * chunkSamples;
+      for (int z = 0; z < chunkSamples; z += step) {
+	indices[n++] = x * chunkSamples + z;
+	indices[n++] = (x + step) * chunkSamples + z;
+      }
+      if (x < chunkQuads - step)
+	indices[n++] = (x + step) * chunkSamples + chunkQuads;
+    }
+    gLevelSurface[l] = n - gLevelFirst[l];
+
+    /* each edge of the chunk, top and bottom alternating */
+    for (int e = 0; e < 4; e++) {
+      int last = 0;
+      for (int i = 0; i < chunkSamples; i += step) {
+	int cx = (e == 1) ? chunkQuads : ((e == 3) ? 0 : i);
+	int cz = (e == 2) ? chunkQuads : ((e == 0) ? 0 : i);
+	if ((i == 0) && (e > 0))
+	  indices[n++] = cx * chunkSamples + cz;
+	indices[n++] = cx * chunkSamples + cz;
+	indices[n++] = last = chunkGridVertices + e * chunkSamples + i;
+      }
+      if (e < 3)
+	indices[n++] = last;
+    }
+    gLevelSkirt[l] = n - gLevelFirst[l] - gLevelSurface[l];
+    gLevelTriangles[l] = 2 * quads * quads + 4 * 2 * quads;
+  }
+  return n;
+}
+
+/************ BUFFERS ***************/
+
+void TerrainCreate(const World *world)
+{
+  int maxIndices = 0;
+  GLushort *indices;
+  int numIndices;
+
+  gGridSize = world->gridSize;
+  gChunksPerLine = (gGridSize - 1 + chunkQuads - 1) / chunkQuads;
+  gNumChunks = gChunksPerLine * gChunksPerLine;
+
+  for (int l = 0; l < numLevels; l++) {
+    int quads = chunkQuads >> l;
+    maxIndices += quads * (2 * (quads + 1) + 2) + 4 * (2 * (quads + 1) + 2);
+  }
+  indices = (GLushort *) malloc(maxIndices * sizeof(GLushort));
+  numIndices = buildIndices(indices);
+
+  free(gChunks);
+  free(gVertices);
+  gChunks = (TerrainChunk *) malloc(gNumChunks * sizeof(TerrainChunk));
+  gVertices = (TerrainVertex *) malloc((size_t) gNumChunks * chunkVertices * sizeof(TerrainVertex));
+  ThreadPoolRun(gNumChunks, buildChunkTask, (void *) world);
+
+  if (gVertexBuffer == 0) {
+    glGenBuffers(1, &gVertexBuffer);
+    glGenBuffers(1, &gIndexBuffer);
+  }
+  glBindBuffer(GL_ARRAY_BUFFER, gVertexBuffer);
+  glBufferData(GL_ARRAY_BUFFER, (size_t) gNumChunks * chunkVertices * sizeof(TerrainVertex),
+	       gVertices, GL_STATIC_DRAW);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, gIndexBuffer);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, numIndices * sizeof(GLushort), indices, GL_STATIC_DRAW);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+  free(indices);
+  printf("Terrain: %d chunks of %d vertices, %d levels\n", gNumChunks, chunkVertices, numLevels);
+}
+
+void TerrainUpdate(const World *world, int x0, int z0, int x1, int z1)
+{
+  int first[2], last[2];
+
+  // the normals of the samples around the rectangle change too
+  x0 = (x0 > 0) ? x0 - 1 : 0;
+  z0 = (z0 > 0) ? z0 - 1 : 0;
+  x1 = (x1 < gGridSize - 1) ? x1 + 1 : gGridSize - 1;
+  z1 = (z1 < gGridSize - 1) ? z1 + 1 : gGridSize - 1;
+
+  // a sample on the border of two chunks belongs to both
+  first[0] = (x0 > 0) ? (x0 - 1) / chunkQuads : 0;
+  first[1] = (z0 > 0) ? (z0 - 1) / chunkQuads : 0;
+  last[0] = std::min(x1 / chunkQuads, gChunksPerLine - 1);
+  last[1] = std::min(z1 / chunkQuads, gChunksPerLine - 1);
+
+  glBindBuffer(GL_ARRAY_BUFFER, gVertexBuffer);
+  for (int i = first[0]; i <= last[0]; i++) {
+    for (int j = first[1]; j <= last[1]; j++) {
+      int chunk = i * gChunksPerLine + j;
+      buildChunk(world, chunk);
+      glBufferSubData(GL_ARRAY_BUFFER, (size_t) chunk * chunkVertices * sizeof(TerrainVertex),
+		      chunkVertices * sizeof(TerrainVertex),
+		      &gVertices[(size_t) chunk * chunkVertices]);
+    }
+  }
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+/************ DRAWING ***************/
+
+/*
+  Coarsest level of a chunk whose error, seen from the eye at the
+  nearest point of the chunk, stays under maxPixelError pixels.
+*/
+int chooseLevel(const TerrainChunk *chunk, const float eye[3], float pixelScale) {
+  float lo[3] = { (float) chunk->x, chunk->minY, (float) chunk->z };
+  float hi[3] = { (float) (chunk->x + chunkQuads), chunk->maxY, (float) (chunk->z + chunkQuads) };
+  float dist = 0.;
+  int level = 0;
+
+  for (int k = 0; k < 3; k++) {
+    float d = (eye[k] < lo[k]) ? lo[k] - eye[k] : ((eye[k] > hi[k]) ? eye[k] - hi[k] : 0.);
+    dist += d * d;
+  }
+  dist = std::max((float) sqrt(dist), 1.f);
+
+  while ((level + 1 < numLevels) &&
+	 (chunk->error[level + 1] * pixelScale / dist <= maxPixelError))
+    level++;
+  return level;
+}
+
+int TerrainDraw(const Frustum *frustum, CullCounts *chunks)
+{
+  GLfloat modelview[16], proj[16];
+  GLint viewport[4];
+  float eye[3];
+  float pixelScale;
+  int triangles = 0;
+
+  chunks->drawn = chunks->culled = 0;
+
+  /* the eye is the modelview translation taken back through its rotation */
+  glGetFloatv(GL_MODELVIEW_MATRIX, modelview);
+  glGetFloatv(GL_PROJECTION_MATRIX, proj);
+  glGetIntegerv(GL_VIEWPORT, viewport);
+  for (int k = 0; k < 3; k++)
+    eye[k] = -(modelview[4*k] * modelview[12] + modelview[4*k+1] * modelview[13]
+	       + modelview[4*k+2] * modelview[14]);
+  /* pixels covered by one unit at distance one */
+  pixelScale = 0.5f * viewport[3] * proj[5];
+
+  glBindBuffer(GL_ARRAY_BUFFER, gVertexBuffer);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, gIndexBuffer);
+  glEnableClientState(GL_VERTEX_ARRAY);
+  glEnableClientState(GL_NORMAL_ARRAY);
+  glEnableClientState(GL_COLOR_ARRAY);
+
+  for (int chunk = 0; chunk < gNumChunks; chunk++) {
+    const TerrainChunk *c = &gChunks[chunk];
+    float lo[3] = { (float) c->x, c->minY, (float) c->z };
+    float hi[3] = { (float) (c->x + chunkQuads), c->maxY, (float) (c->z + chunkQuads) };
+
+    if (!FrustumBox(frustum, lo, hi)) {
+      chunks->culled++;
+      continue;
+    }
+    chunks->drawn++;
+
+    const int level = chooseLevel(c, eye, pixelScale);
+    const char *base = (const char *) 0 + (size_t) chunk * chunkVertices * sizeof(TerrainVertex);
+
+    // every chunk shares the indices, so point the arrays at its own vertices
+    glVertexPointer(3, GL_FLOAT, sizeof(TerrainVertex), base);
+    glNormalPointer(GL_FLOAT, sizeof(TerrainVertex), base + 3 * sizeof(float));
+    glColorPointer(3, GL_FLOAT, sizeof(TerrainVertex), base + 6 * sizeof(float));
+
+    glDrawElements(GL_TRIANGLE_STRIP, gLevelSurface[level], GL_UNSIGNED_SHORT,
+		   (void *) (gLevelFirst[level] * sizeof(GLushort)));
+    glDrawElements(GL_TRIANGLE_STRIP, gLevelSkirt[level], GL_UNSIGNED_SHORT,
+		   (void *) ((gLevelFirst[level] + gLevelSurface[level]) * sizeof(GLushort)));
+    triangles += gLevelTriangles[level];
+  }
+
+  glDisableClientState(GL_COLOR_ARRAY);
+  glDisableClientState(GL_NORMAL_ARRAY);
+  glDisableClientState(GL_VERTEX_ARRAY);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  return triangles;
+}
@@ -0,0 +1,40 @@
+#ifndef Terrain_h
+#define Terrain_h
+
+/*
+ Terrain mesh for pacman.
+
+ The map is cut into square chunks of 64 x 64 quads. Each chunk keeps
+ one vertex per heightMap sample - position, normal and colour
+ interleaved in a single vertex buffer - plus a skirt hanging under
+ its four edges. Every chunk has the same layout, so one small index
+ buffer serves all of them: a triangle strip over the grid and one
+ around the skirt for each level of detail, where level l keeps only
+ every (1 << l)th sample.
+
+ TerrainDraw skips the chunks whose bounding box is outside the view
+ frustum. For every other chunk it picks the level each frame from how
+ many pixels its height error would cover at its distance from the
+ eye, so far away chunks cost a handful of triangles and the total
+ stays about the same however big the map is. The skirts hide the cracks where two
+ chunks of different levels meet; on the border of the map they are
+ the sides of the terrain block.
+
+ TerrainCreate builds both buffers once. TerrainUpdate rebuilds the
+ chunks that cover a rectangle of the map in place, so a change to the
+ world only re-uploads the chunks it touched.
+ */
+
+#include "Game.h"
+#include "Frustum.h"
+
+/* build the terrain buffers from the world */
+void TerrainCreate(const World *world);
+
+/* rebuild the vertices of the samples in [x0, x1] x [z0, z1] */
+void TerrainUpdate(const World *world, int x0, int z0, int x1, int z1);
+
+/* draw the chunks inside the frustum, returns the number of triangles */
+int TerrainDraw(const Frustum *frustum, CullCounts *chunks);
+
+#endif
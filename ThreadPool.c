@@ -0,0 +1,153 @@
+#include <stdlib.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "ThreadPool.h"
+
+static pthread_t *g_Workers;
+static int g_NumWorkers;
+static int g_Stopping;
+
+/* the job being run */
+static ThreadTask g_Task;
+static void *g_Context;
+static int g_NumTasks;
+static int g_NextTask;
+static unsigned int g_Generation;
+static int g_Finished;
+
+static pthread_mutex_t g_Lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t g_RunLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_JobReady = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t g_JobDone = PTHREAD_COND_INITIALIZER;
+
+/* set on pool threads, so nested jobs run inline */
+static __thread int t_InTask;
+
+/* claim and run tasks until none are left */
+static void RunTasks(ThreadTask task, void *context, int numTasks)
+{
+	int next;
+
+	t_InTask = 1;
+	while ((next = __sync_fetch_and_add(&g_NextTask, 1)) < numTasks)
+	{
+		task(context, next);
+	}
+	t_InTask = 0;
+}
+
+static void *WorkerMain(void *unused)
+{
+	unsigned int seen = 0;
+
+	(void)unused;
+	pthread_mutex_lock(&g_Lock);
+	for (;;)
+	{
+		while (!g_Stopping && (g_Generation == seen))
+		{
+			pthread_cond_wait(&g_JobReady, &g_Lock);
+		}
+		if (g_Stopping)
+		{
+			break;
+		}
+		seen = g_Generation;
+		pthread_mutex_unlock(&g_Lock);
+
+		RunTasks(g_Task, g_Context, g_NumTasks);
+
+		pthread_mutex_lock(&g_Lock);
+		if (++g_Finished == g_NumWorkers)
+		{
+			pthread_cond_signal(&g_JobDone);
+		}
+	}
+	pthread_mutex_unlock(&g_Lock);
+	return NULL;
+}
+
+void ThreadPoolStart(int threads)
+{
+	int i;
+
+	if (threads <= 0)
+	{
+		threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+	}
+	if (threads < 1)
+	{
+		threads = 1;
+	}
+
+	/* the caller is one of the threads */
+	g_Stopping = 0;
+	g_NumWorkers = threads - 1;
+	g_Workers = (pthread_t *)malloc(sizeof(pthread_t) * (g_NumWorkers + 1));
+	for (i = 0; i < g_NumWorkers; i++)
+	{
+		pthread_create(&g_Workers[i], NULL, WorkerMain, NULL);
+	}
+}
+
+void ThreadPoolRun(int numTasks, ThreadTask task, void *context)
+{
+	int i;
+
+	if ((g_NumWorkers == 0) || t_InTask || (numTasks == 1))
+	{
+		for (i = 0; i < numTasks; i++)
+		{
+			task(context, i);
+		}
+		return;
+	}
+
+	pthread_mutex_lock(&g_RunLock);
+
+	pthread_mutex_lock(&g_Lock);
+	g_Task = task;
+	g_Context = context;
+	g_NumTasks = numTasks;
+	g_NextTask = 0;
+	g_Finished = 0;
+	g_Generation++;
+	pthread_cond_broadcast(&g_JobReady);
+	pthread_mutex_unlock(&g_Lock);
+
+	RunTasks(task, context, numTasks);
+
+	/* every task is claimed - wait until each worker has finished with
+	   this job, so none of them can pick up the next one half way */
+	pthread_mutex_lock(&g_Lock);
+	while (g_Finished < g_NumWorkers)
+	{
+		pthread_cond_wait(&g_JobDone, &g_Lock);
+	}
+	pthread_mutex_unlock(&g_Lock);
+
+	pthread_mutex_unlock(&g_RunLock);
+}
+
+int ThreadPoolSize(void)
+{
+	return g_NumWorkers + 1;
+}
+
+void ThreadPoolStop(void)
+{
+	int i;
+
+	pthread_mutex_lock(&g_Lock);
+	g_Stopping = 1;
+	pthread_cond_broadcast(&g_JobReady);
+	pthread_mutex_unlock(&g_Lock);
+
+	for (i = 0; i < g_NumWorkers; i++)
+	{
+		pthread_join(g_Workers[i], NULL);
+	}
+	free(g_Workers);
+	g_Workers = NULL;
+	g_NumWorkers = 0;
+}
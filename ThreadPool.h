@@ -0,0 +1,33 @@
+#ifndef ThreadPool_h
+#define ThreadPool_h
+
+/*
+ A small pool of worker threads shared by everything in pacman.
+
+ ThreadPoolRun splits a job into numbered tasks and runs them on the
+ workers and on the calling thread, returning once every task is done.
+ Tasks are handed out one at a time as threads become free, so a job
+ with uneven tasks still keeps every core busy.
+
+ Results must never depend on which thread ran which task - work that
+ needs random numbers takes them from the task number, not from the
+ thread. A job started from inside a task simply runs on the thread
+ that started it.
+ */
+
+/* the work for one task of a job */
+typedef void (*ThreadTask)(void *context, int task);
+
+/* start the workers - 0 means one thread per core */
+void ThreadPoolStart(int threads);
+
+/* run tasks 0 .. numTasks-1 of a job and wait for all of them */
+void ThreadPoolRun(int numTasks, ThreadTask task, void *context);
+
+/* number of threads working on a job, including the caller */
+int ThreadPoolSize(void);
+
+/* stop and join the workers */
+void ThreadPoolStop(void);
+
+#endif
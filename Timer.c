@@ -1,90 +1,171 @@
-#include <time.h>
-#include <stdio.h>
-#include "Timer.h"
-
-#ifdef WINDOWS
-#include <Windows.h>
-
-static unsigned int g_PreviousTick;
-static unsigned int g_FrameCount;
-static unsigned int g_LastSecondTick;
-static float g_TimeDelta;
-
-void InitialiseTimer()
-{
-	g_PreviousTick = GetTickCount();
-	g_LastSecondTick = g_PreviousTick;
-	g_FrameCount = 0;
-	g_TimeDelta = 0.0f;
-}
-
-unsigned char ProcessTimer(unsigned int *framespersecond)
-{
-	unsigned char retval = 0;
-	unsigned int tick = GetTickCount();
-
-	*framespersecond = g_FrameCount;
-	g_TimeDelta = (tick - g_PreviousTick) / 1000.0f;
-
-	if (tick - g_LastSecondTick >= 1000)
-	{
-		retval = 1;
-		g_FrameCount = 0;
-		g_LastSecondTick = tick;
-	}
-	g_PreviousTick = tick;
-	g_FrameCount++;
-
-	return retval;
-}
-
-float GetPreviousFrameDeltaInSeconds()
-{
-	return g_TimeDelta;
-}
-
-#else
-
-static time_t g_PreviousTimeValue;
-static unsigned int g_FrameCount;
-static unsigned int g_PreviousFPS;
-
-void InitialiseTimer()
-{
-	g_PreviousTimeValue = time(NULL);
-	g_FrameCount = 0;
-	g_PreviousFPS = 0;
-}
-
-unsigned char ProcessTimer(unsigned int *framespersecond)
-{
-	unsigned char retval = 0;
-	time_t tick = time(NULL);
-
-	*framespersecond = g_FrameCount;
-
-	if (tick - g_PreviousTimeValue >= 1)
-	{
-		retval = 1;
-		g_PreviousFPS = g_FrameCount;
-		g_FrameCount = 0;
-		g_PreviousTimeValue = tick;
-	}
-	g_FrameCount++;
-
-	return retval;
-}
-
-float GetPreviousFrameDeltaInSeconds()
-{
-	if (g_PreviousFPS == 0)
-	{
-		return 0.01f;
-	}
-	else
-	{
-		return 1.0f / (float)g_PreviousFPS;
-	}
-}
-
-#endif
+#include <time.h>
+#include <stdio.h>
+#include <string.h>
+#include "Timer.h"
+
+/* the frame time histogram - FRAME_BUCKETS buckets of FRAME_BUCKET_WIDTH
+   seconds each, the last bucket also holds everything slower */
+#define FRAME_BUCKETS 1000
+#define FRAME_BUCKET_WIDTH 0.0001
+
+static float g_Window[FRAME_WINDOW];
+static unsigned int g_WindowNext;
+static unsigned int g_WindowCount;
+static unsigned int g_Histogram[FRAME_BUCKETS];
+
+static unsigned int g_FrameCount;
+static double g_PreviousTime;
+static double g_LastSecondTime;
+static float g_TimeDelta;
+
+#ifdef WINDOWS
+#include <Windows.h>
+
+static double g_CounterPeriod;
+
+double GetTimeInSeconds()
+{
+	LARGE_INTEGER counter;
+
+	if (g_CounterPeriod == 0.0)
+	{
+		LARGE_INTEGER frequency;
+		QueryPerformanceFrequency(&frequency);
+		g_CounterPeriod = 1.0 / (double)frequency.QuadPart;
+	}
+	QueryPerformanceCounter(&counter);
+	return (double)counter.QuadPart * g_CounterPeriod;
+}
+
+#else
+
+double GetTimeInSeconds()
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (double)now.tv_sec + (double)now.tv_nsec * 1e-9;
+}
+
+#endif
+
+static unsigned int BucketOf(float seconds)
+{
+	unsigned int bucket = (unsigned int)(seconds / FRAME_BUCKET_WIDTH);
+
+	if (bucket >= FRAME_BUCKETS)
+	{
+		bucket = FRAME_BUCKETS - 1;
+	}
+	return bucket;
+}
+
+/* add a frame time to the window, dropping the oldest one once it is full */
+static void RecordFrameTime(float seconds)
+{
+	if (g_WindowCount == FRAME_WINDOW)
+	{
+		g_Histogram[BucketOf(g_Window[g_WindowNext])]--;
+	}
+	else
+	{
+		g_WindowCount++;
+	}
+	g_Window[g_WindowNext] = seconds;
+	g_Histogram[BucketOf(seconds)]++;
+	g_WindowNext = (g_WindowNext + 1) % FRAME_WINDOW;
+}
+
+/* the upper edge of the bucket holding the given fraction of the window */
+static float Percentile(float fraction)
+{
+	unsigned int wanted = (unsigned int)(fraction * (g_WindowCount - 1)) + 1;
+	unsigned int seen = 0;
+	unsigned int bucket;
+
+	for (bucket = 0; bucket < FRAME_BUCKETS - 1; bucket++)
+	{
+		seen += g_Histogram[bucket];
+		if (seen >= wanted)
+		{
+			break;
+		}
+	}
+	return (float)((bucket + 1) * FRAME_BUCKET_WIDTH);
+}
+
+void InitialiseTimer()
+{
+	g_PreviousTime = GetTimeInSeconds();
+	g_LastSecondTime = g_PreviousTime;
+	g_FrameCount = 0;
+	g_TimeDelta = 0.0f;
+
+	g_WindowNext = 0;
+	g_WindowCount = 0;
+	memset(g_Histogram, 0, sizeof(g_Histogram));
+}
+
+unsigned char ProcessTimer(unsigned int *framespersecond)
+{
+	unsigned char retval = 0;
+	double now = GetTimeInSeconds();
+
+	*framespersecond = g_FrameCount;
+	g_TimeDelta = (float)(now - g_PreviousTime);
+	RecordFrameTime(g_TimeDelta);
+
+	if (now - g_LastSecondTime >= 1.0)
+	{
+		retval = 1;
+		g_FrameCount = 0;
+		g_LastSecondTime = now;
+	}
+	g_PreviousTime = now;
+	g_FrameCount++;
+
+	return retval;
+}
+
+float GetPreviousFrameDeltaInSeconds()
+{
+	return g_TimeDelta;
+}
+
+void GetFrameTimeStats(FrameTimeStats *stats)
+{
+	unsigned int i;
+
+	memset(stats, 0, sizeof(*stats));
+	stats->frames = g_WindowCount;
+	if (g_WindowCount == 0)
+	{
+		return;
+	}
+
+	stats->min = g_Window[0];
+	stats->max = g_Window[0];
+	for (i = 1; i < g_WindowCount; i++)
+	{
+		if (g_Window[i] < stats->min)
+		{
+			stats->min = g_Window[i];
+		}
+		if (g_Window[i] > stats->max)
+		{
+			stats->max = g_Window[i];
+		}
+	}
+
+	/* the histogram only resolves to a bucket, never report past the slowest frame */
+	stats->median = Percentile(0.50f);
+	stats->p99 = Percentile(0.99f);
+	if (stats->median > stats->max)
+	{
+		stats->median = stats->max;
+	}
+	if (stats->p99 > stats->max)
+	{
+		stats->p99 = stats->max;
+	}
+}